@@ -27,6 +27,7 @@
 #include <boost/lexical_cast.hpp>
 #include <algorithm>
 #include <iostream>
+#include <numeric>
 
 #include "actions.h"
 #include "charset.h"
@@ -35,6 +36,7 @@
 #include "global.h"
 #include "mpdpp.h"
 #include "helpers.h"
+#include "library_snapshot.h"
 #include "statusbar.h"
 #include "utility/comparators.h"
 #include "utility/conversion.h"
@@ -667,16 +669,18 @@ void DeletePlaylistItems::run()
 	if (myScreen == myPlaylist)
 	{
 		Statusbar::print("Deleting items...");
-		deleteSelectedSongsFromPlaylist(myPlaylist->main());
-		Statusbar::print("Item(s) deleted");
+		size_t commands = deleteSelectedSongsFromPlaylist(myPlaylist->main());
+		Statusbar::printf("Item(s) deleted (%1% command%2%)",
+			commands, commands == 1 ? "" : "s");
 	}
 	else if (myScreen->isActiveWindow(myPlaylistEditor->Content))
 	{
 		std::string playlist = myPlaylistEditor->Playlists.current()->value().path();
 		auto delete_fun = std::bind(&MPD::Connection::PlaylistDelete, ph::_1, playlist, ph::_2);
 		Statusbar::print("Deleting items...");
-		deleteSelectedSongs(myPlaylistEditor->Content, delete_fun);
-		Statusbar::print("Item(s) deleted");
+		size_t commands = deleteSelectedSongs(myPlaylistEditor->Content, delete_fun);
+		Statusbar::printf("Item(s) deleted (%1% command%2%)",
+			commands, commands == 1 ? "" : "s");
 	}
 }
 
@@ -717,7 +721,7 @@ void DeleteBrowserItems::run()
 	};
 
 	boost::format question;
-	if (hasSelected(myBrowser->main().begin(), myBrowser->main().end()))
+	if (myBrowser->main().hasSelected())
 		question = boost::format("Delete selected items?");
 	else
 	{
@@ -733,11 +737,7 @@ void DeleteBrowserItems::run()
 	}
 	confirmAction(question);
 
-	auto items = getSelectedOrCurrent(
-		myBrowser->main().begin(),
-		myBrowser->main().end(),
-		myBrowser->main().current()
-	);
+	auto items = getSelectedOrCurrent(myBrowser->main());
 	for (const auto &item : items)
 	{
 		myBrowser->remove(item->value());
@@ -763,17 +763,13 @@ void DeleteStoredPlaylist::run()
 	if (myPlaylistEditor->Playlists.empty())
 		return;
 	boost::format question;
-	if (hasSelected(myPlaylistEditor->Playlists.begin(), myPlaylistEditor->Playlists.end()))
+	if (myPlaylistEditor->Playlists.hasSelected())
 		question = boost::format("Delete selected playlists?");
 	else
 		question = boost::format("Delete playlist \"%1%\"?")
 			% wideShorten(myPlaylistEditor->Playlists.current()->value().path(), COLS-question.size()-10);
 	confirmAction(question);
-	auto list = getSelectedOrCurrent(
-		myPlaylistEditor->Playlists.begin(),
-		myPlaylistEditor->Playlists.end(),
-		myPlaylistEditor->Playlists.current()
-	);
+	auto list = getSelectedOrCurrent(myPlaylistEditor->Playlists);
 	for (const auto &item : list)
 		Mpd.DeletePlaylist(item->value().path());
 	Statusbar::printf("%1% deleted", list.size() == 1 ? "Playlist" : "Playlists");
@@ -980,13 +976,13 @@ void MoveSelectedItemsTo::run()
 	if (myScreen == myPlaylist)
 	{
 		if (!myPlaylist->main().empty())
-			moveSelectedItemsTo(myPlaylist->main(), std::bind(&MPD::Connection::Move, ph::_1, ph::_2, ph::_3));
+			moveSelectedItemsTo(myPlaylist->main(), std::bind(&MPD::Connection::MoveRange, ph::_1, ph::_2, ph::_3, ph::_4));
 	}
 	else
 	{
 		assert(!myPlaylistEditor->Playlists.empty());
 		std::string playlist = myPlaylistEditor->Playlists.current()->value().path();
-		auto move_fun = std::bind(&MPD::Connection::PlaylistMove, ph::_1, playlist, ph::_2, ph::_3);
+		auto move_fun = std::bind(&MPD::Connection::PlaylistMoveRange, ph::_1, playlist, ph::_2, ph::_3, ph::_4);
 		moveSelectedItemsTo(myPlaylistEditor->Content, move_fun);
 	}
 }
@@ -1446,6 +1442,7 @@ void EditLibraryTag::run()
 	if (!new_tag.empty() && new_tag != myLibrary->Tags.current()->value().tag())
 	{
 		Statusbar::print("Updating tags...");
+		MPD::ScopedTagTypes all_tags(Mpd, {});
 		Mpd.StartSearch(true);
 		Mpd.AddSearch(Config.media_lib_primary_tag, myLibrary->Tags.current()->value().tag());
 		MPD::MutableSong::SetFunction set = tagTypeToSetFunction(Config.media_lib_primary_tag);
@@ -1785,8 +1782,7 @@ bool SelectItem::canBeRun()
 
 void SelectItem::run()
 {
-	auto current = m_list->currentP();
-	current->setSelected(!current->isSelected());
+	m_list->setSelected(m_list->choice(), !m_list->currentP()->isSelected());
 }
 
 bool SelectRange::canBeRun()
@@ -1801,8 +1797,9 @@ bool SelectRange::canBeRun()
 
 void SelectRange::run()
 {
+	auto first = m_list->beginP();
 	for (; m_begin != m_end; ++m_begin)
-		m_begin->setSelected(true);
+		m_list->setSelected(m_begin - first, true);
 	Statusbar::print("Range selected");
 }
 
@@ -1814,8 +1811,7 @@ bool ReverseSelection::canBeRun()
 
 void ReverseSelection::run()
 {
-	for (auto &p : *m_list)
-		p.setSelected(!p.isSelected());
+	m_list->reverseSelection();
 	Statusbar::print("Selection reversed");
 }
 
@@ -1827,8 +1823,7 @@ bool RemoveSelection::canBeRun()
 
 void RemoveSelection::run()
 {
-	for (auto &p : *m_list)
-		p.setSelected(false);
+	m_list->removeSelection();
 	Statusbar::print("Selection removed");
 }
 
@@ -1856,12 +1851,12 @@ void SelectAlbum::run()
 		--it;
 		if (it->song() == nullptr || it->song()->getTags(get) != tag)
 			break;
-		it->properties().setSelected(true);
+		m_list->setSelected(it - front, true);
 	}
 	// go down
 	for (auto it = current;;)
 	{
-		it->properties().setSelected(true);
+		m_list->setSelected(it - front, true);
 		if (++it == end)
 			break;
 		if (it->song() == nullptr || it->song()->getTags(get) != tag)
@@ -1887,9 +1882,9 @@ void SelectFoundItems::run()
 	if (found)
 	{
 		Statusbar::print("Searching for items...");
-		m_list->currentP()->setSelected(true);
+		m_list->setSelected(m_list->choice(), true);
 		while (m_searchable->search(SearchDirection::Forward, false, true))
-			m_list->currentP()->setSelected(true);
+			m_list->setSelected(m_list->choice(), true);
 		Statusbar::print("Found items selected");
 	}
 	m_list->highlight(current_pos);
@@ -1915,9 +1910,10 @@ void CropMainPlaylist::run()
 		confirmAction("Do you really want to crop main playlist?");
 	Statusbar::print("Cropping playlist...");
 	selectCurrentIfNoneSelected(w);
-	reverseSelectionHelper(w.begin(), w.end());
-	deleteSelectedSongsFromPlaylist(w);
-	Statusbar::print("Playlist cropped");
+	w.reverseSelection();
+	size_t commands = deleteSelectedSongsFromPlaylist(w);
+	Statusbar::printf("Playlist cropped (%1% command%2%)",
+		commands, commands == 1 ? "" : "s");
 }
 
 bool CropPlaylist::canBeRun()
@@ -1937,8 +1933,9 @@ void CropPlaylist::run()
 		confirmAction(boost::format("Do you really want to crop playlist \"%1%\"?") % playlist);
 	selectCurrentIfNoneSelected(w);
 	Statusbar::printf("Cropping playlist \"%1%\"...", playlist);
-	cropPlaylist(w, std::bind(&MPD::Connection::PlaylistDelete, ph::_1, playlist, ph::_2));
-	Statusbar::printf("Playlist \"%1%\" cropped", playlist);
+	size_t commands = cropPlaylist(w, std::bind(&MPD::Connection::PlaylistDelete, ph::_1, playlist, ph::_2));
+	Statusbar::printf("Playlist \"%1%\" cropped (%2% command%3%)",
+		playlist, commands, commands == 1 ? "" : "s");
 }
 
 void ClearMainPlaylist::run()
@@ -1991,10 +1988,15 @@ bool ReversePlaylist::canBeRun()
 void ReversePlaylist::run()
 {
 	Statusbar::print("Reversing range...");
-	Mpd.StartCommandsList();
-	for (--m_end; m_begin < m_end; ++m_begin, --m_end)
-		Mpd.Swap(m_begin->value().getPosition(), m_end->value().getPosition());
-	Mpd.CommitCommandsList();
+	--m_end;
+	size_t first = m_begin->value().getPosition();
+	std::vector<size_t> order(m_end->value().getPosition() - first + 1);
+	std::iota(order.begin(), order.end(), 0);
+	// if the playlist is filtered, songs that are not visible stay in place
+	for (; m_begin < m_end; ++m_begin, --m_end)
+		std::swap(order[m_begin->value().getPosition() - first],
+		          order[m_end->value().getPosition() - first]);
+	reorderPlaylist(first, order);
 	Statusbar::print("Range reversed");
 }
 
@@ -2022,7 +2024,8 @@ void ApplyFilter::run()
 		Statusbar::ScopedLock slock;
 		NC::Window::ScopedPromptHook helper(
 			*wFooter,
-			Statusbar::Helpers::ApplyFilterImmediately(m_filterable));
+			Statusbar::Helpers::ApplyFilterImmediately(m_filterable),
+			Config.incremental_search_delay);
 		Statusbar::put() << "Apply filter: ";
 		filter = wFooter->prompt(filter);
 	}
@@ -2234,7 +2237,7 @@ void AddRandomItems::run()
 	{
 		bool success;
 		if (rnd_type == 's')
-			success = Mpd.AddRandomSongs(number, Config.random_exclude_pattern, Global::RNG);
+			success = Mpd.AddRandomSongs(Library.songs(), number, Config.random_exclude_pattern, Global::RNG);
 		else
 			success = Mpd.AddRandomTag(tag_type, number, Global::RNG);
 		if (success)
@@ -2273,11 +2276,13 @@ void ToggleBrowserSortMode::run()
 	}
 	if (Config.browser_sort_mode != SortMode::None)
 	{
+		auto &w = myBrowser->main();
 		size_t sort_offset = myBrowser->inRootDirectory() ? 0 : 1;
-		std::stable_sort(
-			myBrowser->main().begin()+sort_offset, myBrowser->main().end(),
-			LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the,
-			                       Config.browser_sort_mode));
+		w.reorder(sort_offset, w.size(), [](auto first, auto last) {
+			sortByKeyOf(first, last,
+			            LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the,
+			                                   Config.browser_sort_mode));
+		});
 	}
 }
 
@@ -2308,6 +2313,7 @@ void ToggleLibraryTagType::run()
 	if (new_tagitem != Config.media_lib_primary_tag)
 	{
 		Config.media_lib_primary_tag = new_tagitem;
+		restrictTagTypes();
 		std::string item_type = tagTypeToString(Config.media_lib_primary_tag);
 		myLibrary->Tags.setTitle(Config.titles_visibility ? item_type + "s" : "");
 		myLibrary->Tags.reset();
@@ -2603,6 +2609,16 @@ void ResetSearchEngine::run()
 	mySearcher->reset();
 }
 
+bool StopSearching::canBeRun()
+{
+	return myScreen == mySearcher && mySearcher->isSearching();
+}
+
+void StopSearching::run()
+{
+	mySearcher->stopSearching();
+}
+
 bool ShowMediaLibrary::canBeRun()
 {
 	return myScreen != myLibrary
@@ -2862,6 +2878,7 @@ void populateActions()
 	insert_action(new Actions::ChangeBrowseMode());
 	insert_action(new Actions::ShowSearchEngine());
 	insert_action(new Actions::ResetSearchEngine());
+	insert_action(new Actions::StopSearching());
 	insert_action(new Actions::ShowMediaLibrary());
 	insert_action(new Actions::ToggleMediaLibraryColumnsMode());
 	insert_action(new Actions::ShowPlaylistEditor());
@@ -3070,7 +3087,8 @@ void findItem(const SearchDirection direction)
 		Statusbar::ScopedLock slock;
 		NC::Window::ScopedPromptHook prompt_hook(
 			*wFooter,
-			Statusbar::Helpers::FindImmediately(w, direction));
+			Statusbar::Helpers::FindImmediately(w, direction),
+			Config.incremental_search_delay);
 		Statusbar::put() << (boost::format("Find %1%: ") % direction).str();
 		constraint = wFooter->prompt(constraint);
 	}
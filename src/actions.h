@@ -156,6 +156,7 @@ enum class Type
 	ChangeBrowseMode,
 	ShowSearchEngine,
 	ResetSearchEngine,
+	StopSearching,
 	ShowMediaLibrary,
 	ToggleMediaLibraryColumnsMode,
 	ShowPlaylistEditor,
@@ -1350,6 +1351,15 @@ private:
 	virtual void run() override;
 };
 
+struct StopSearching: BaseAction
+{
+	StopSearching(): BaseAction(Type::StopSearching, "stop_searching") { }
+	
+private:
+	virtual bool canBeRun() override;
+	virtual void run() override;
+};
+
 struct ShowMediaLibrary: BaseAction
 {
 	ShowMediaLibrary(): BaseAction(Type::ShowMediaLibrary, "show_media_library") { }
@@ -574,6 +574,7 @@ void BindingsConfiguration::generateDefaults()
 	if (notBound(k = stringToKey("3")))
 	{
 		bind(k, Actions::Type::ShowSearchEngine);
+		bind(k, Actions::Type::StopSearching);
 		bind(k, Actions::Type::ResetSearchEngine);
 	}
 	if (notBound(k = stringToKey("4")))
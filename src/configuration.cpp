@@ -31,6 +31,7 @@
 #include "config.h"
 #include "mpdpp.h"
 #include "format_impl.h"
+#include "regex_filter.h"
 #include "settings.h"
 #include "utility/string.h"
 
@@ -194,6 +195,12 @@ bool configure(int argc, char **argv)
 		std::for_each(config_paths.begin(), config_paths.end(), expand_home);
 		if (Config.read(config_paths, vm.count("ignore-config-errors")) == false)
 			exit(1);
+#ifdef BOOST_REGEX_ICU
+		// Tag values are searched with diacritics stripped, so do it only once
+		// per value.
+		if (Config.ignore_diacritics)
+			MPD::Song::StripDiacritics = Regex::stripDiacritics;
+#endif // BOOST_REGEX_ICU
 
 		// read bindings
 		std::for_each(bindings_paths.begin(), bindings_paths.end(), expand_home);
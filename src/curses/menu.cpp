@@ -0,0 +1,135 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <bitset>
+#include <cassert>
+
+#include "curses/menu.h"
+
+namespace {
+
+size_t countBits(uint64_t word)
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(word);
+#else
+	return std::bitset<64>(word).count();
+#endif
+}
+
+size_t lowestBit(uint64_t word)
+{
+	assert(word != 0);
+#if defined(__GNUC__)
+	return __builtin_ctzll(word);
+#else
+	size_t result = 0;
+	for (; !(word & 1); word >>= 1)
+		++result;
+	return result;
+#endif
+}
+
+}
+
+namespace NC {
+
+void SelectionIndex::set(size_t pos, bool is_selected)
+{
+	assert(pos < m_size);
+	Word &word = m_bits[pos / WordBits];
+	Word mask = Word(1) << (pos % WordBits);
+	if (bool(word & mask) == is_selected)
+		return;
+	if (is_selected)
+	{
+		word |= mask;
+		++m_count;
+	}
+	else
+	{
+		word &= ~mask;
+		--m_count;
+	}
+}
+
+size_t SelectionIndex::findNext(size_t pos) const
+{
+	if (pos >= m_size)
+		return m_size;
+	size_t i = pos / WordBits;
+	Word word = m_bits[i] & (~Word(0) << (pos % WordBits));
+	while (word == 0)
+	{
+		if (++i == m_bits.size())
+			return m_size;
+		word = m_bits[i];
+	}
+	return i*WordBits + lowestBit(word);
+}
+
+void SelectionIndex::push_back(bool is_selected)
+{
+	if (m_size % WordBits == 0)
+		m_bits.push_back(0);
+	++m_size;
+	set(m_size-1, is_selected);
+}
+
+void SelectionIndex::insert(size_t pos, bool is_selected)
+{
+	assert(pos <= m_size);
+	push_back(false);
+	// Shift bits starting from pos by one.
+	size_t first = pos / WordBits;
+	for (size_t i = m_bits.size()-1; i > first; --i)
+		m_bits[i] = (m_bits[i] << 1) | (m_bits[i-1] >> (WordBits-1));
+	Word preceding = (Word(1) << (pos % WordBits)) - 1;
+	m_bits[first] = (m_bits[first] & preceding) | ((m_bits[first] & ~preceding) << 1);
+	set(pos, is_selected);
+}
+
+void SelectionIndex::resize(size_t new_size)
+{
+	m_bits.resize((new_size + WordBits - 1) / WordBits, 0);
+	// Bits past the end have to stay unset.
+	if (new_size % WordBits != 0)
+		m_bits.back() &= (Word(1) << (new_size % WordBits)) - 1;
+	bool shrunk = new_size < m_size;
+	m_size = new_size;
+	if (shrunk)
+		recount();
+}
+
+void SelectionIndex::clear()
+{
+	m_bits.clear();
+	m_size = 0;
+	m_count = 0;
+}
+
+void SelectionIndex::recount()
+{
+	m_count = 0;
+	for (auto word : m_bits)
+		m_count += countBits(word);
+}
+
+}
@@ -21,13 +21,22 @@
 #ifndef NCMPCPP_MENU_H
 #define NCMPCPP_MENU_H
 
+#include <boost/iterator/iterator_facade.hpp>
 #include <boost/iterator/transform_iterator.hpp>
 #include <boost/range/detail/any_iterator.hpp>
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <exception>
 #include <functional>
 #include <iterator>
 #include <memory>
 #include <set>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
 
 #include "curses/formatted_color.h"
 #include "curses/strbuffer.h"
@@ -52,21 +61,14 @@ struct List
 		: m_properties(properties)
 		{ }
 
+		// Selection is changed only by the menu holding the item (see
+		// Menu::setSelected), so it's left as it is.
 		void setSelectable(bool is_selectable)
 		{
 			if (is_selectable)
 				m_properties |= Selectable;
 			else
-				m_properties &= ~(Selectable | Selected);
-		}
-		void setSelected(bool is_selected)
-		{
-			if (!isSelectable())
-				return;
-			if (is_selected)
-				m_properties |= Selected;
-			else
-				m_properties &= ~Selected;
+				m_properties &= ~Selectable;
 		}
 		void setInactive(bool is_inactive)
 		{
@@ -89,6 +91,16 @@ struct List
 		bool isSeparator() const { return m_properties & Separator; }
 
 	private:
+		template <typename> friend struct Menu;
+
+		void setSelected(bool is_selected)
+		{
+			if (is_selected)
+				m_properties |= Selected;
+			else
+				m_properties &= ~Selected;
+		}
+
 		unsigned m_properties;
 	};
 
@@ -116,6 +128,11 @@ struct List
 	virtual ConstIterator beginP() const = 0;
 	virtual Iterator endP() = 0;
 	virtual ConstIterator endP() const = 0;
+
+	virtual bool hasSelected() const = 0;
+	virtual void setSelected(size_t pos, bool is_selected) = 0;
+	virtual void reverseSelection() = 0;
+	virtual void removeSelection() = 0;
 };
 
 inline List::Properties::Type operator|(List::Properties::Type lhs, List::Properties::Type rhs)
@@ -143,6 +160,91 @@ inline List::ConstIterator begin(const List &list) { return list.beginP(); }
 inline List::Iterator end(List &list) { return list.endP(); }
 inline List::ConstIterator end(const List &list) { return list.endP(); }
 
+/// Bitmap of selected items of a menu along with their number, so that the
+/// selection can be queried without going through all of the items. Menus
+/// update it along with Selected flags of their items.
+struct SelectionIndex
+{
+	SelectionIndex() : m_size(0), m_count(0) { }
+
+	/// @return number of items
+	size_t size() const { return m_size; }
+
+	/// @return number of selected items
+	size_t count() const { return m_count; }
+
+	bool test(size_t pos) const {
+		return m_bits[pos / WordBits] & (Word(1) << (pos % WordBits));
+	}
+	void set(size_t pos, bool is_selected);
+
+	/// @return position of the first selected item not before pos or size() if
+	/// there is no such item
+	size_t findNext(size_t pos) const;
+
+	void push_back(bool is_selected);
+	void insert(size_t pos, bool is_selected);
+	void resize(size_t new_size);
+	void clear();
+
+private:
+	template <typename> friend struct Menu;
+
+	typedef uint64_t Word;
+	static const size_t WordBits = 64;
+
+	void recount();
+
+	std::vector<Word> m_bits;
+	size_t m_size;
+	size_t m_count;
+};
+
+/// Relation between sets of items accepted by two filter predicates.
+enum class FilterRelation { Unrelated, Narrower, Same };
+
+namespace detail {
+
+// Filter predicates may optionally provide:
+// - FilterRelation relationTo(const PredicateT &previous) const, so that the
+//   results of previously applied predicates can be reused,
+// - bool isThreadSafe() const, so that big lists can be filtered in parallel.
+
+template <typename PredicateT, typename = void>
+struct HasFilterRelation : std::false_type { };
+
+template <typename PredicateT>
+struct HasFilterRelation<PredicateT, decltype(void(
+	std::declval<const PredicateT &>().relationTo(std::declval<const PredicateT &>())))>
+	: std::true_type { };
+
+template <typename PredicateT>
+auto filterRelation(const PredicateT &pred, const PredicateT &previous, int)
+	-> decltype(pred.relationTo(previous))
+{
+	return pred.relationTo(previous);
+}
+
+template <typename PredicateT>
+FilterRelation filterRelation(const PredicateT &, const PredicateT &, long)
+{
+	return FilterRelation::Unrelated;
+}
+
+template <typename PredicateT>
+auto filterIsThreadSafe(const PredicateT &pred, int) -> decltype(pred.isThreadSafe())
+{
+	return pred.isThreadSafe();
+}
+
+template <typename PredicateT>
+bool filterIsThreadSafe(const PredicateT &, long)
+{
+	return false;
+}
+
+}
+
 /// Generic menu capable of holding any std::vector compatible values.
 template <typename ItemT>
 struct Menu: Window, List
@@ -153,27 +255,22 @@ struct Menu: Window, List
 
 		typedef ItemT Type;
 
-		Item()
-			: m_impl(std::make_shared<std::tuple<ItemT, Properties>>())
-		{ }
+		Item() : m_value() { }
 
 		template <typename ValueT, typename PropertiesT>
 		Item(ValueT &&value_, PropertiesT properties_)
-			: m_impl(
-				std::make_shared<std::tuple<ItemT, List::Properties>>(
-					std::forward<ValueT>(value_),
-					std::forward<PropertiesT>(properties_)))
+			: m_value(std::forward<ValueT>(value_))
+			, m_properties(std::forward<PropertiesT>(properties_))
 		{ }
 
-		ItemT &value() { return std::get<0>(*m_impl); }
-		const ItemT &value() const { return std::get<0>(*m_impl); }
+		ItemT &value() { return m_value; }
+		const ItemT &value() const { return m_value; }
 
-		Properties &properties() { return std::get<1>(*m_impl); }
-		const Properties &properties() const { return std::get<1>(*m_impl); }
+		Properties &properties() { return m_properties; }
+		const Properties &properties() const { return m_properties; }
 
 		// Forward methods to List::Properties.
 		void setSelectable(bool is_selectable) { properties().setSelectable(is_selectable); }
-		void setSelected (bool is_selected) { properties().setSelected(is_selected); }
 		void setInactive (bool is_inactive) { properties().setInactive(is_inactive); }
 		void setSeparator (bool is_separator) { properties().setSeparator(is_separator); }
 
@@ -182,9 +279,10 @@ struct Menu: Window, List
 		bool isInactive() const { return properties().isInactive(); }
 		bool isSeparator() const { return properties().isSeparator(); }
 
-		// Make a deep copy of Item.
+		// Make a copy of Item (items are stored by value, so it's the same as
+		// copying it directly).
 		Item copy() const {
-			return Item(value(), properties());
+			return *this;
 		}
 
 	private:
@@ -234,11 +332,67 @@ struct Menu: Window, List
 			return item;
 		}
 		
-		std::shared_ptr<std::tuple<ItemT, Properties>> m_impl;
+		ItemT m_value;
+		Properties m_properties;
 	};
 
-	typedef typename std::vector<Item>::iterator Iterator;
-	typedef typename std::vector<Item>::const_iterator ConstIterator;
+	/// Iterator over items of the menu. If the menu is filtered, it goes through
+	/// positions of the filtered items in the list of all items.
+	template <Const const_>
+	struct ItemIterator: boost::iterator_facade<
+		ItemIterator<const_>,
+		typename std::conditional<const_ == Const::Yes, const Item, Item>::type,
+		std::random_access_iterator_tag>
+	{
+		typedef typename std::conditional<
+			const_ == Const::Yes,
+			const Item,
+			Item>::type Item_;
+
+		ItemIterator()
+			: m_items(nullptr), m_positions(nullptr), m_index(0)
+		{ }
+
+		ItemIterator(Item_ *items, const size_t *positions, std::ptrdiff_t index)
+			: m_items(items), m_positions(positions), m_index(index)
+		{ }
+
+		// Allow conversion of Iterator to ConstIterator.
+		template <Const other_const_,
+		          typename = typename std::enable_if<
+			          const_ == Const::Yes || other_const_ == Const::No>::type>
+		ItemIterator(const ItemIterator<other_const_> &rhs)
+			: m_items(rhs.m_items), m_positions(rhs.m_positions), m_index(rhs.m_index)
+		{ }
+
+	private:
+		friend class boost::iterator_core_access;
+		template <Const> friend struct ItemIterator;
+
+		Item_ &dereference() const {
+			return m_positions != nullptr
+				? m_items[m_positions[m_index]]
+				: m_items[m_index];
+		}
+		template <Const other_const_>
+		bool equal(const ItemIterator<other_const_> &rhs) const {
+			return m_index == rhs.m_index;
+		}
+		void increment() { ++m_index; }
+		void decrement() { --m_index; }
+		void advance(std::ptrdiff_t n) { m_index += n; }
+		template <Const other_const_>
+		std::ptrdiff_t distance_to(const ItemIterator<other_const_> &rhs) const {
+			return rhs.m_index - m_index;
+		}
+
+		Item_ *m_items;
+		const size_t *m_positions;
+		std::ptrdiff_t m_index;
+	};
+
+	typedef ItemIterator<Const::No> Iterator;
+	typedef ItemIterator<Const::Yes> ConstIterator;
 	typedef std::reverse_iterator<Iterator> ReverseIterator;
 	typedef std::reverse_iterator<ConstIterator> ConstReverseIterator;
 
@@ -299,6 +453,16 @@ struct Menu: Window, List
 	/// Inserts separator to list at given position
 	/// @param pos initial position of inserted separator
 	void insertSeparator(size_t pos);
+
+	/// Rotates items in range [first, last) so that the one at middle becomes
+	/// the first one (adequate to std::rotate()). If the menu is filtered,
+	/// items are moved only between places of the filtered ones.
+	void rotate(size_t first, size_t middle, size_t last);
+
+	/// Rearranges items in range [first, last) by calling reorder_fun with
+	/// iterators to them. It may only permute the items (e.g. sort them).
+	template <typename ReorderT>
+	void reorder(size_t first, size_t last, ReorderT &&reorder_fun);
 	
 	/// Moves the highlighted position to the given line of window
 	/// @param y Y position of menu window to be highlighted
@@ -307,10 +471,12 @@ struct Menu: Window, List
 	
 	/// Checks if list is empty
 	/// @return true if list is empty, false otherwise
-	virtual bool empty() const override { return m_items->empty(); }
+	virtual bool empty() const override { return size() == 0; }
 
 	/// @return size of the list
-	virtual size_t size() const override { return m_items->size(); }
+	virtual size_t size() const override {
+		return m_filtered ? m_filtered_positions.size() : m_all_items.size();
+	}
 
 	/// @return currently highlighted position
 	virtual size_t choice() const override;
@@ -336,11 +502,13 @@ struct Menu: Window, List
 	void reset();
 
 	/// Apply filter predicate to items in the menu and show the ones for which it
-	/// returned true.
+	/// returned true. Results of recently applied predicates are remembered, so
+	/// if the new one is equivalent to or narrower than one of them (see
+	/// FilterRelation), only the items it accepted are checked.
 	template <typename PredicateT>
 	void applyFilter(PredicateT &&pred);
 
-	/// Reapply previously applied filter.
+	/// Reapply previously applied filter (e.g. after items were modified).
 	void reapplyFilter();
 
 	/// Get current filter predicate.
@@ -351,13 +519,35 @@ struct Menu: Window, List
 	void clearFilter();
 
 	/// @return true if menu is filtered.
-	bool isFiltered() const { return m_items == &m_filtered_items; }
+	bool isFiltered() const { return m_filtered; }
 
 	/// Show all items.
-	void showAllItems() { m_items = &m_all_items; }
+	void showAllItems() { m_filtered = false; }
 
 	/// Show filtered items.
-	void showFilteredItems() { m_items = &m_filtered_items; }
+	void showFilteredItems() { m_filtered = true; }
+
+	/// @return position of the item at given position in the list of all
+	/// items (it's different if the menu is filtered)
+	size_t unfilteredPosition(size_t pos) const {
+		return m_filtered ? m_filtered_positions[pos] : pos;
+	}
+
+	/// @return true if any of the items is selected
+	virtual bool hasSelected() const override;
+
+	/// Selects or unselects item at given position. Items that are not
+	/// selectable are left as they are.
+	virtual void setSelected(size_t pos, bool is_selected) override;
+
+	/// @return positions of selected items in ascending order
+	std::vector<size_t> selectedPositions() const;
+
+	/// Reverses selection of the items
+	virtual void reverseSelection() override;
+
+	/// Unselects all items
+	virtual void removeSelection() override;
 
 	/// Sets prefix, that is put before each selected item to indicate its selection
 	/// Note that the passed variable is not deleted along with menu object.
@@ -398,23 +588,35 @@ struct Menu: Window, List
 	/// @param pos requested position
 	/// @return reference to item at given position
 	/// @throw std::out_of_range if given position is out of range
-	Menu<ItemT>::Item &at(size_t pos) { return m_items->at(pos); }
+	Menu<ItemT>::Item &at(size_t pos) {
+		if (pos >= size())
+			throw std::out_of_range("Menu::at: position out of range");
+		return (*this)[pos];
+	}
 	
 	/// @param pos requested position
 	/// @return const reference to item at given position
 	/// @throw std::out_of_range if given position is out of range
-	const Menu<ItemT>::Item &at(size_t pos) const { return m_items->at(pos); }
+	const Menu<ItemT>::Item &at(size_t pos) const {
+		if (pos >= size())
+			throw std::out_of_range("Menu::at: position out of range");
+		return (*this)[pos];
+	}
 	
 	/// @param pos requested position
 	/// @return const reference to item at given position
-	const Menu<ItemT>::Item &operator[](size_t pos) const { return (*m_items)[pos]; }
+	const Menu<ItemT>::Item &operator[](size_t pos) const {
+		return m_all_items[unfilteredPosition(pos)];
+	}
 	
 	/// @param pos requested position
 	/// @return const reference to item at given position
-	Menu<ItemT>::Item &operator[](size_t pos) { return (*m_items)[pos]; }
+	Menu<ItemT>::Item &operator[](size_t pos) {
+		return m_all_items[unfilteredPosition(pos)];
+	}
 	
-	Iterator current() { return Iterator(m_items->begin() + m_highlight); }
-	ConstIterator current() const { return ConstIterator(m_items->begin() + m_highlight); }
+	Iterator current() { return begin() + m_highlight; }
+	ConstIterator current() const { return begin() + m_highlight; }
 	ReverseIterator rcurrent() {
 		if (empty())
 			return rend();
@@ -428,8 +630,8 @@ struct Menu: Window, List
 			return ConstReverseIterator(++current());
 	}
 
-	ValueIterator currentV() { return ValueIterator(m_items->begin() + m_highlight); }
-	ConstValueIterator currentV() const { return ConstValueIterator(m_items->begin() + m_highlight); }
+	ValueIterator currentV() { return ValueIterator(current()); }
+	ConstValueIterator currentV() const { return ConstValueIterator(current()); }
 	ReverseValueIterator rcurrentV() {
 		if (empty())
 			return rendV();
@@ -443,10 +645,14 @@ struct Menu: Window, List
 			return ConstReverseValueIterator(++currentV());
 	}
 	
-	Iterator begin() { return Iterator(m_items->begin()); }
-	ConstIterator begin() const { return ConstIterator(m_items->begin()); }
-	Iterator end() { return Iterator(m_items->end()); }
-	ConstIterator end() const { return ConstIterator(m_items->end()); }
+	Iterator begin() {
+		return Iterator(m_all_items.data(), m_filtered ? m_filtered_positions.data() : nullptr, 0);
+	}
+	ConstIterator begin() const {
+		return ConstIterator(m_all_items.data(), m_filtered ? m_filtered_positions.data() : nullptr, 0);
+	}
+	Iterator end() { return begin() + size(); }
+	ConstIterator end() const { return begin() + size(); }
 	
 	ReverseIterator rbegin() { return ReverseIterator(end()); }
 	ConstReverseIterator rbegin() const { return ConstReverseIterator(end()); }
@@ -464,37 +670,66 @@ struct Menu: Window, List
 	ConstReverseValueIterator rendV() const { return ConstReverseValueIterator(beginV()); }
 	
 	virtual List::Iterator currentP() override {
-		return List::Iterator(PropertiesIterator(m_items->begin() + m_highlight));
+		return List::Iterator(PropertiesIterator(current()));
 	}
 	virtual List::ConstIterator currentP() const override {
-		return List::ConstIterator(ConstPropertiesIterator(m_items->begin() + m_highlight));
+		return List::ConstIterator(ConstPropertiesIterator(current()));
 	}
 	virtual List::Iterator beginP() override {
-		return List::Iterator(PropertiesIterator(m_items->begin()));
+		return List::Iterator(PropertiesIterator(begin()));
 	}
 	virtual List::ConstIterator beginP() const override {
-		return List::ConstIterator(ConstPropertiesIterator(m_items->begin()));
+		return List::ConstIterator(ConstPropertiesIterator(begin()));
 	}
 	virtual List::Iterator endP() override {
-		return List::Iterator(PropertiesIterator(m_items->end()));
+		return List::Iterator(PropertiesIterator(end()));
 	}
 	virtual List::ConstIterator endP() const override {
-		return List::ConstIterator(ConstPropertiesIterator(m_items->end()));
+		return List::ConstIterator(ConstPropertiesIterator(end()));
 	}
 
 private:
+	/// Result of a filter, i.e. positions of the items in m_all_items it
+	/// accepted.
+	struct FilterResult
+	{
+		FilterPredicate predicate;
+		std::vector<size_t> positions;
+	};
+
+	/// Number of the most recently applied filters whose results are kept.
+	static const size_t MaxFilterResults = 16;
+
 	bool isHighlightable(size_t pos)
 	{
-		return !(*m_items)[pos].isSeparator()
-			&& !(*m_items)[pos].isInactive();
+		return !(*this)[pos].isSeparator()
+			&& !(*this)[pos].isInactive();
 	}
 
+	std::vector<size_t> filterPositions(const std::vector<size_t> *candidates) const;
+	void clearFilterResults();
+	void itemAdded();
+	void itemInserted(size_t pos);
+
+	/// Call f(position, position in m_all_items) for each selected item in
+	/// ascending order as long as it returns true.
+	template <typename FunT>
+	void forEachSelected(FunT f) const;
+	void updateSelection(size_t pos);
+
 	ItemDisplayer m_item_displayer;
 	FilterPredicate m_filter_predicate;
+	bool m_filter_thread_safe;
 
-	std::vector<Item> *m_items;
+	std::vector<FilterResult> m_filter_results;
+
+	// Items are stored by value in one place, filtered ones are referred to by
+	// their positions.
 	std::vector<Item> m_all_items;
-	std::vector<Item> m_filtered_items;
+	std::vector<size_t> m_filtered_positions;
+	bool m_filtered;
+
+	SelectionIndex m_selection;
 	
 	size_t m_beginning;
 	size_t m_highlight;
@@ -27,8 +27,9 @@ namespace NC {
 
 template <typename ItemT>
 Menu<ItemT>::Menu()
+	: m_filter_thread_safe(false)
+	, m_filtered(false)
 {
-	m_items = &m_all_items;
 }
 
 template <typename ItemT>
@@ -42,6 +43,8 @@ Menu<ItemT>::Menu(size_t startx,
 	: Window(startx, starty, width, height, title, color, border)
 	, m_item_displayer(nullptr)
 	, m_filter_predicate(nullptr)
+	, m_filter_thread_safe(false)
+	, m_filtered(false)
 	, m_beginning(0)
 	, m_highlight(0)
 	, m_highlight_enabled(true)
@@ -51,7 +54,6 @@ Menu<ItemT>::Menu(size_t startx,
 	auto fc = FormattedColor(m_base_color, {Format::Reverse});
 	m_highlight_prefix << fc;
 	m_highlight_suffix << FormattedColor::End<>(fc);
-	m_items = &m_all_items;
 }
 
 template <typename ItemT>
@@ -59,6 +61,11 @@ Menu<ItemT>::Menu(const Menu &rhs)
 	: Window(rhs)
 	, m_item_displayer(rhs.m_item_displayer)
 	, m_filter_predicate(rhs.m_filter_predicate)
+	, m_filter_thread_safe(rhs.m_filter_thread_safe)
+	, m_all_items(rhs.m_all_items)
+	, m_filtered_positions(rhs.m_filtered_positions)
+	, m_filtered(rhs.m_filtered)
+	, m_selection(rhs.m_selection)
 	, m_beginning(rhs.m_beginning)
 	, m_highlight(rhs.m_highlight)
 	, m_highlight_enabled(rhs.m_highlight_enabled)
@@ -70,11 +77,6 @@ Menu<ItemT>::Menu(const Menu &rhs)
 	, m_selected_prefix(rhs.m_selected_prefix)
 	, m_selected_suffix(rhs.m_selected_suffix)
 {
-	// TODO: move filtered items
-	m_all_items.reserve(rhs.m_all_items.size());
-	for (const auto &item : rhs.m_all_items)
-		m_all_items.push_back(item.copy());
-	m_items = &m_all_items;
 }
 
 template <typename ItemT>
@@ -82,8 +84,11 @@ Menu<ItemT>::Menu(Menu &&rhs)
 	: Window(rhs)
 	, m_item_displayer(std::move(rhs.m_item_displayer))
 	, m_filter_predicate(std::move(rhs.m_filter_predicate))
+	, m_filter_thread_safe(rhs.m_filter_thread_safe)
 	, m_all_items(std::move(rhs.m_all_items))
-	, m_filtered_items(std::move(rhs.m_filtered_items))
+	, m_filtered_positions(std::move(rhs.m_filtered_positions))
+	, m_filtered(rhs.m_filtered)
+	, m_selection(std::move(rhs.m_selection))
 	, m_beginning(rhs.m_beginning)
 	, m_highlight(rhs.m_highlight)
 	, m_highlight_enabled(rhs.m_highlight_enabled)
@@ -95,10 +100,7 @@ Menu<ItemT>::Menu(Menu &&rhs)
 	, m_selected_prefix(std::move(rhs.m_selected_prefix))
 	, m_selected_suffix(std::move(rhs.m_selected_suffix))
 {
-	if (rhs.m_items == &rhs.m_all_items)
-		m_items = &m_all_items;
-	else
-		m_items = &m_filtered_items;
+	rhs.m_selection.clear();
 }
 
 template <typename ItemT>
@@ -107,8 +109,11 @@ Menu<ItemT> &Menu<ItemT>::operator=(Menu rhs)
 	std::swap(static_cast<Window &>(*this), static_cast<Window &>(rhs));
 	std::swap(m_item_displayer, rhs.m_item_displayer);
 	std::swap(m_filter_predicate, rhs.m_filter_predicate);
+	std::swap(m_filter_thread_safe, rhs.m_filter_thread_safe);
 	std::swap(m_all_items, rhs.m_all_items);
-	std::swap(m_filtered_items, rhs.m_filtered_items);
+	std::swap(m_filtered_positions, rhs.m_filtered_positions);
+	std::swap(m_filtered, rhs.m_filtered);
+	std::swap(m_selection, rhs.m_selection);
 	std::swap(m_beginning, rhs.m_beginning);
 	std::swap(m_highlight, rhs.m_highlight);
 	std::swap(m_highlight_enabled, rhs.m_highlight_enabled);
@@ -119,10 +124,7 @@ Menu<ItemT> &Menu<ItemT>::operator=(Menu rhs)
 	std::swap(m_highlight_suffix, rhs.m_highlight_suffix);
 	std::swap(m_selected_prefix, rhs.m_selected_prefix);
 	std::swap(m_selected_suffix, rhs.m_selected_suffix);
-	if (rhs.m_items == &rhs.m_all_items)
-		m_items = &m_all_items;
-	else
-		m_items = &m_filtered_items;
+	clearFilterResults();
 	return *this;
 }
 
@@ -130,36 +132,114 @@ template <typename ItemT> template <typename ItemDisplayerT>
 void Menu<ItemT>::setItemDisplayer(ItemDisplayerT &&displayer)
 {
 	m_item_displayer = std::forward<ItemDisplayerT>(displayer);
+	// Filters usually match displayed strings, so a different way of displaying
+	// items might change their results.
+	clearFilterResults();
 }
 
 template <typename ItemT>
 void Menu<ItemT>::resizeList(size_t new_size)
 {
 	m_all_items.resize(new_size);
+	// Drop filtered items that no longer exist.
+	m_filtered_positions.erase(
+		std::lower_bound(m_filtered_positions.begin(), m_filtered_positions.end(), new_size),
+		m_filtered_positions.end());
+	m_selection.resize(new_size);
+	clearFilterResults();
 }
 
 template <typename ItemT>
 void Menu<ItemT>::addItem(ItemT item, Properties::Type properties)
 {
 	m_all_items.push_back(Item(std::move(item), properties));
+	itemAdded();
 }
 
 template <typename ItemT>
 void Menu<ItemT>::addSeparator()
 {
 	m_all_items.push_back(Item::mkSeparator());
+	itemAdded();
 }
 
 template <typename ItemT>
 void Menu<ItemT>::insertItem(size_t pos, ItemT item, Properties::Type properties)
 {
 	m_all_items.insert(m_all_items.begin()+pos, Item(std::move(item), properties));
+	itemInserted(pos);
 }
 
 template <typename ItemT>
 void Menu<ItemT>::insertSeparator(size_t pos)
 {
 	m_all_items.insert(m_all_items.begin()+pos, Item::mkSeparator());
+	itemInserted(pos);
+}
+
+template <typename ItemT>
+void Menu<ItemT>::rotate(size_t first, size_t middle, size_t last)
+{
+	assert(first <= middle && middle <= last && last <= size());
+	if (m_filtered)
+	{
+		// Filtered items are only moved between the places of each other, so
+		// their positions stay the same.
+		std::rotate(begin() + first, begin() + middle, begin() + last);
+		for (size_t pos = first; pos < last; ++pos)
+			updateSelection(m_filtered_positions[pos]);
+	}
+	else
+	{
+		std::rotate(m_all_items.begin() + first,
+		            m_all_items.begin() + middle,
+		            m_all_items.begin() + last);
+		for (size_t pos = first; pos < last; ++pos)
+			updateSelection(pos);
+		// Positions of filtered items (if they're just temporarily not shown)
+		// need to follow them.
+		auto filtered_first = std::lower_bound(
+			m_filtered_positions.begin(), m_filtered_positions.end(), first);
+		auto filtered_middle = std::lower_bound(
+			filtered_first, m_filtered_positions.end(), middle);
+		auto filtered_last = std::lower_bound(
+			filtered_middle, m_filtered_positions.end(), last);
+		for (auto it = filtered_first; it != filtered_last; ++it)
+		{
+			if (*it < middle)
+				*it += last - middle;
+			else
+				*it -= middle - first;
+		}
+		std::rotate(filtered_first, filtered_middle, filtered_last);
+	}
+	// Results of other filters refer to the previous positions.
+	clearFilterResults();
+}
+
+template <typename ItemT> template <typename ReorderT>
+void Menu<ItemT>::reorder(size_t first, size_t last, ReorderT &&reorder_fun)
+{
+	assert(first <= last && last <= size());
+	reorder_fun(begin() + first, begin() + last);
+	if (m_filtered)
+	{
+		// Filtered items are only moved between the places of each other, so
+		// their positions stay the same.
+		for (size_t pos = first; pos < last; ++pos)
+			updateSelection(m_filtered_positions[pos]);
+	}
+	else
+	{
+		for (size_t pos = first; pos < last; ++pos)
+			updateSelection(pos);
+		// It's not known where filtered items (if they're just temporarily not
+		// shown) were moved to, so they need to be found again.
+		if (m_filter_predicate)
+			m_filtered_positions = filterPositions(nullptr);
+	}
+	// Results of other filters refer to the previous positions.
+	clearFilterResults();
 }
 
 template <typename ItemT>
@@ -174,7 +254,7 @@ bool Menu<ItemT>::Goto(size_t y)
 template <typename ItemT>
 void Menu<ItemT>::refresh()
 {
-	if (m_items->empty())
+	if (empty())
 	{
 		Window::clear();
 		Window::refresh();
@@ -182,14 +262,14 @@ void Menu<ItemT>::refresh()
 	}
 
 	size_t max_beginning = 0;
-	if (m_items->size() > m_height)
-		max_beginning = m_items->size() - m_height;
+	if (size() > m_height)
+		max_beginning = size() - m_height;
 	m_beginning = std::min(m_beginning, max_beginning);
 
 	// if highlighted position is off the screen, make it visible
 	m_highlight = std::min(m_highlight, m_beginning+m_height-1);
 	// if highlighted position is invalid, correct it
-	m_highlight = std::min(m_highlight, m_items->size()-1);
+	m_highlight = std::min(m_highlight, size()-1);
 
 	if (!isHighlightable(m_highlight))
 	{
@@ -204,25 +284,25 @@ void Menu<ItemT>::refresh()
 	for (; m_drawn_position < end_; ++m_drawn_position, ++line)
 	{
 		goToXY(0, line);
-		if (m_drawn_position >= m_items->size())
+		if (m_drawn_position >= size())
 		{
 			for (; line < m_height; ++line)
 				mvwhline(m_window, line, 0, NC::Key::Space, m_width);
 			break;
 		}
-		if ((*m_items)[m_drawn_position].isSeparator())
+		if ((*this)[m_drawn_position].isSeparator())
 		{
 			mvwhline(m_window, line, 0, 0, m_width);
 			continue;
 		}
 		if (m_highlight_enabled && m_drawn_position == m_highlight)
 			*this << m_highlight_prefix;
-		if ((*m_items)[m_drawn_position].isSelected())
+		if ((*this)[m_drawn_position].isSelected())
 			*this << m_selected_prefix;
 		*this << NC::TermManip::ClearToEOL;
 		if (m_item_displayer)
 			m_item_displayer(*this);
-		if ((*m_items)[m_drawn_position].isSelected())
+		if ((*this)[m_drawn_position].isSelected())
 			*this << m_selected_suffix;
 		if (m_highlight_enabled && m_drawn_position == m_highlight)
 			*this << m_highlight_suffix;
@@ -233,10 +313,10 @@ void Menu<ItemT>::refresh()
 template <typename ItemT>
 void Menu<ItemT>::scroll(Scroll where)
 {
-	if (m_items->empty())
+	if (empty())
 		return;
-	size_t max_highlight = m_items->size()-1;
-	size_t max_beginning = m_items->size() < m_height ? 0 : m_items->size()-m_height;
+	size_t max_highlight = size()-1;
+	size_t max_beginning = size() < m_height ? 0 : size()-m_height;
 	size_t max_visible_highlight = m_beginning+m_height-1;
 	switch (where)
 	{
@@ -333,13 +413,15 @@ void Menu<ItemT>::clear()
 {
 	// Don't clear filter related stuff here.
 	m_all_items.clear();
-	m_filtered_items.clear();
+	m_filtered_positions.clear();
+	m_selection.clear();
+	clearFilterResults();
 }
 
 template <typename ItemT>
 void Menu<ItemT>::highlight(size_t pos)
 {
-	assert(pos < m_items->size());
+	assert(pos < size());
 	m_highlight = pos;
 	size_t half_height = m_height/2;
 	if (pos < half_height)
@@ -358,19 +440,58 @@ size_t Menu<ItemT>::choice() const
 template <typename ItemT> template <typename PredicateT>
 void Menu<ItemT>::applyFilter(PredicateT &&pred)
 {
+	typedef typename std::decay<PredicateT>::type Predicate;
+
+	m_filter_thread_safe = detail::filterIsThreadSafe(pred, 0);
 	m_filter_predicate = std::forward<PredicateT>(pred);
-	m_filtered_items.clear();
 
-	for (const auto &item : m_all_items)
-		if (m_filter_predicate(item))
-			m_filtered_items.push_back(item);
+	auto same = m_filter_results.end();
+	const std::vector<size_t> *candidates = nullptr;
+	const Predicate *current = m_filter_predicate.template target<Predicate>();
+	if (detail::HasFilterRelation<Predicate>::value && current != nullptr)
+	{
+		for (auto it = m_filter_results.begin(); it != m_filter_results.end(); ++it)
+		{
+			const Predicate *previous = it->predicate.template target<Predicate>();
+			if (previous == nullptr)
+				continue;
+			auto relation = detail::filterRelation(*current, *previous, 0);
+			if (relation == FilterRelation::Same)
+				same = it;
+			else if (relation == FilterRelation::Narrower
+			         && (candidates == nullptr || it->positions.size() < candidates->size()))
+				candidates = &it->positions;
+		}
+	}
 
-	m_items = &m_filtered_items;
+	if (same != m_filter_results.end())
+	{
+		// Mark the result as the most recently used one.
+		FilterResult result = std::move(*same);
+		m_filter_results.erase(same);
+		m_filtered_positions = result.positions;
+		m_filter_results.push_back(std::move(result));
+	}
+	else
+	{
+		m_filtered_positions = filterPositions(candidates);
+		if (detail::HasFilterRelation<Predicate>::value && current != nullptr)
+		{
+			if (m_filter_results.size() == MaxFilterResults)
+				m_filter_results.erase(m_filter_results.begin());
+			m_filter_results.push_back(FilterResult{m_filter_predicate, m_filtered_positions});
+		}
+	}
+
+	m_filtered = true;
 }
 
 template <typename ItemT>
 void Menu<ItemT>::reapplyFilter()
 {
+	// Items were modified in place, so results of all filters might be
+	// different now.
+	clearFilterResults();
 	applyFilter(m_filter_predicate);
 }
 
@@ -384,8 +505,208 @@ template <typename ItemT>
 void Menu<ItemT>::clearFilter()
 {
 	m_filter_predicate = nullptr;
-	m_filtered_items.clear();
-	m_items = &m_all_items;
+	m_filtered_positions.clear();
+	m_filtered = false;
+	// Items might be modified while they're not filtered.
+	clearFilterResults();
+}
+
+template <typename ItemT>
+std::vector<size_t> Menu<ItemT>::filterPositions(const std::vector<size_t> *candidates) const
+{
+	const size_t parallel_threshold = 10000;
+	const size_t max_threads = 8;
+
+	const size_t count = candidates != nullptr ? candidates->size() : m_all_items.size();
+
+	size_t chunks = 1;
+	if (m_filter_thread_safe && count >= parallel_threshold)
+		chunks = std::max(std::min<size_t>(std::thread::hardware_concurrency(), max_threads),
+		                  size_t(1));
+
+	std::vector<std::vector<size_t>> results(chunks);
+	std::vector<std::exception_ptr> errors(chunks);
+	auto filter_chunk = [&](size_t chunk) {
+		try
+		{
+			for (size_t i = count * chunk / chunks; i < count * (chunk+1) / chunks; ++i)
+			{
+				size_t pos = candidates != nullptr ? (*candidates)[i] : i;
+				if (m_filter_predicate(m_all_items[pos]))
+					results[chunk].push_back(pos);
+			}
+		}
+		catch (...)
+		{
+			errors[chunk] = std::current_exception();
+		}
+	};
+	std::vector<std::thread> threads;
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+	{
+		try
+		{
+			threads.emplace_back(filter_chunk, chunk);
+		}
+		catch (std::system_error &)
+		{
+			filter_chunk(chunk);
+		}
+	}
+	filter_chunk(0);
+	for (auto &thread : threads)
+		thread.join();
+	for (auto &error : errors)
+		if (error)
+			std::rethrow_exception(error);
+
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+		results[0].insert(results[0].end(), results[chunk].begin(), results[chunk].end());
+	return std::move(results[0]);
+}
+
+template <typename ItemT>
+void Menu<ItemT>::clearFilterResults()
+{
+	m_filter_results.clear();
+}
+
+template <typename ItemT>
+void Menu<ItemT>::itemAdded()
+{
+	m_selection.push_back(m_all_items.back().isSelected());
+	clearFilterResults();
+}
+
+template <typename ItemT>
+void Menu<ItemT>::itemInserted(size_t pos)
+{
+	// Filtered items after the inserted one moved by one position.
+	for (auto it = std::lower_bound(m_filtered_positions.begin(), m_filtered_positions.end(), pos);
+	     it != m_filtered_positions.end(); ++it)
+		++*it;
+	m_selection.insert(pos, m_all_items[pos].isSelected());
+	clearFilterResults();
+}
+
+template <typename ItemT>
+bool Menu<ItemT>::hasSelected() const
+{
+	if (!m_filtered)
+		return m_selection.count() > 0;
+	bool result = false;
+	forEachSelected([&result](size_t, size_t) {
+		result = true;
+		return false;
+	});
+	return result;
+}
+
+template <typename ItemT>
+void Menu<ItemT>::setSelected(size_t pos, bool is_selected)
+{
+	auto &item = (*this)[pos];
+	if (!item.isSelectable())
+		return;
+	item.m_properties.setSelected(is_selected);
+	m_selection.set(unfilteredPosition(pos), is_selected);
+}
+
+template <typename ItemT>
+std::vector<size_t> Menu<ItemT>::selectedPositions() const
+{
+	std::vector<size_t> result;
+	forEachSelected([&result](size_t pos, size_t) {
+		result.push_back(pos);
+		return true;
+	});
+	return result;
+}
+
+template <typename ItemT>
+void Menu<ItemT>::reverseSelection()
+{
+	if (m_filtered)
+	{
+		for (size_t pos : m_filtered_positions)
+		{
+			auto &properties = m_all_items[pos].m_properties;
+			if (properties.isSelectable())
+			{
+				properties.setSelected(!properties.isSelected());
+				m_selection.set(pos, properties.isSelected());
+			}
+		}
+	}
+	else
+	{
+		// Flags need to be flipped one by one, but the bitmap is assembled a word
+		// at a time.
+		auto &words = m_selection.m_bits;
+		for (size_t i = 0; i < words.size(); ++i)
+		{
+			SelectionIndex::Word word = 0;
+			size_t first = i * SelectionIndex::WordBits;
+			size_t last = std::min(first + SelectionIndex::WordBits, m_all_items.size());
+			for (size_t pos = first; pos < last; ++pos)
+			{
+				auto &properties = m_all_items[pos].m_properties;
+				if (properties.isSelectable())
+					properties.setSelected(!properties.isSelected());
+				if (properties.isSelected())
+					word |= SelectionIndex::Word(1) << (pos - first);
+			}
+			words[i] = word;
+		}
+		m_selection.recount();
+	}
+}
+
+template <typename ItemT>
+void Menu<ItemT>::removeSelection()
+{
+	forEachSelected([this](size_t, size_t pos) {
+		m_all_items[pos].m_properties.setSelected(false);
+		m_selection.set(pos, false);
+		return true;
+	});
+}
+
+template <typename ItemT> template <typename FunT>
+void Menu<ItemT>::forEachSelected(FunT f) const
+{
+	auto next = [this](size_t pos) { return m_selection.findNext(pos); };
+	if (!m_filtered)
+	{
+		for (size_t pos = next(0); pos < m_selection.size(); pos = next(pos+1))
+			if (!f(pos, pos))
+				return;
+	}
+	// Go through selected or filtered items, whichever there are less of.
+	else if (m_selection.count() < m_filtered_positions.size())
+	{
+		auto first = m_filtered_positions.begin();
+		for (size_t pos = next(0); pos < m_selection.size(); pos = next(pos+1))
+		{
+			first = std::lower_bound(first, m_filtered_positions.end(), pos);
+			if (first == m_filtered_positions.end())
+				return;
+			if (*first == pos && !f(first - m_filtered_positions.begin(), pos))
+				return;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < m_filtered_positions.size(); ++i)
+			if (m_selection.test(m_filtered_positions[i]) && !f(i, m_filtered_positions[i]))
+				return;
+	}
+}
+
+template <typename ItemT>
+void Menu<ItemT>::updateSelection(size_t pos)
+{
+	m_selection.set(pos, m_all_items[pos].isSelected());
 }
 
 }
@@ -194,18 +194,20 @@ OutputStreamT &operator<<(OutputStreamT &os, const BasicBuffer<CharT> &buffer)
 		os << buffer.str();
 	else
 	{
+		// Output text between consecutive properties at once.
 		auto &s = buffer.str();
-		auto &ps = buffer.properties();
-		auto p = ps.begin();
-		for (size_t i = 0;; ++i)
+		size_t i = 0;
+		for (const auto &p : buffer.properties())
 		{
-			for (; p != ps.end() && p->first == i; ++p)
-				os << p->second;
-			if (i < s.size())
-				os << s[i];
-			else
-				break;
+			if (p.first > i)
+			{
+				os << s.substr(i, p.first - i);
+				i = p.first;
+			}
+			os << p.second;
 		}
+		if (i < s.size())
+			os << s.substr(i);
 	}
 	return os;
 }
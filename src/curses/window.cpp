@@ -18,6 +18,7 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <boost/algorithm/string/predicate.hpp>
 #include <algorithm>
 #include <cstring>
 #include <cstdio>
@@ -37,6 +38,20 @@ namespace {
 // run as high as 2^24. We only work with up to 256.
 int maxColor;
 
+// Make the terminal enclose pasted text in escape sequences, so that it can be
+// told apart from typed characters (see Window::getInputChar).
+void enableBracketedPaste()
+{
+	std::printf("\e[?2004h");
+	std::fflush(stdout);
+}
+
+void disableBracketedPaste()
+{
+	std::printf("\e[?2004l");
+	std::fflush(stdout);
+}
+
 namespace rl {
 
 bool aborted;
@@ -48,35 +63,64 @@ size_t width;
 bool encrypted;
 const char *base;
 
+// Line the prompt hook was run with the last time.
+std::string hooked_line;
+bool hook_run;
+
 int read_key(FILE *)
 {
 	size_t x;
 	bool done;
-	int result;
+	NC::Key::Type result;
+	auto read = [&x]() {
+		auto key = w->readKey();
+		if (!w->FDCallbacksListEmpty())
+		{
+			w->goToXY(x, start_y);
+			w->refresh();
+		}
+		return key;
+	};
 	do
 	{
 		x = w->getX();
-		if (w->runPromptHook(rl_line_buffer, &done))
+		result = NC::Key::None;
+		// If the line was modified, wait for further input for a while before
+		// running the hook, so that it's not run after each typed character.
+		if (hook_run && w->getPromptHookDelay() > 0 && hooked_line != rl_line_buffer)
 		{
-			// Do not end if readline is in one of its commands, e.g. searching
-			// through history, as it doesn't actually make readline exit and it
-			// becomes stuck in a loop.
-			if (!RL_ISSTATE(RL_STATE_DISPATCHING) && done)
+			w->refresh();
+			NC::Window::ScopedTimeout timeout(*w, w->getPromptHookDelay());
+			result = read();
+		}
+		if (result == NC::Key::None)
+		{
+			if (w->runPromptHook(rl_line_buffer, &done))
 			{
-				rl_done = 1;
-				return EOF;
+				hooked_line = rl_line_buffer;
+				hook_run = true;
+				// Do not end if readline is in one of its commands, e.g. searching
+				// through history, as it doesn't actually make readline exit and it
+				// becomes stuck in a loop.
+				if (!RL_ISSTATE(RL_STATE_DISPATCHING) && done)
+				{
+					rl_done = 1;
+					return EOF;
+				}
+				w->goToXY(x, start_y);
 			}
-			w->goToXY(x, start_y);
+			w->refresh();
+			result = read();
 		}
-		w->refresh();
-		result = w->readKey();
-		if (!w->FDCallbacksListEmpty())
+		// Insert pasted text as a whole.
+		if (result == NC::Key::Paste)
 		{
-			w->goToXY(x, start_y);
-			w->refresh();
+			rl_insert_text(w->getPastedText().c_str());
+			rl_redisplay();
+			result = NC::Key::None;
 		}
 	}
-	while (result == ERR);
+	while (result == NC::Key::None);
 	return result;
 }
 
@@ -428,6 +472,8 @@ void initScreen(bool enable_colors, bool enable_mouse)
 	Mouse::supportEnabled = enable_mouse;
 	Mouse::enable();
 
+	enableBracketedPaste();
+
 	// initialize readline (needed, otherwise we get segmentation
 	// fault on SIGWINCH). also, initialize first as doing this
 	// later erases keys bound with rl_bind_key for some users.
@@ -461,6 +507,7 @@ void pauseScreen()
 {
 	if (Mouse::supportEnabled)
 		Mouse::disable();
+	disableBracketedPaste();
 	def_prog_mode();
 	endwin();
 }
@@ -469,12 +516,14 @@ void unpauseScreen()
 {
 	if (Mouse::supportEnabled)
 		Mouse::enable();
+	enableBracketedPaste();
 	refresh();
 }
 
 void destroyScreen()
 {
 	Mouse::disable();
+	disableBracketedPaste();
 	curs_set(1);
 	endwin();
 }
@@ -489,6 +538,7 @@ Window::Window(size_t startx, size_t starty, size_t width, size_t height,
 	  m_window_timeout(-1),
 	  m_border(std::move(border)),
 	  m_prompt_hook(0),
+	  m_prompt_hook_delay(0),
 	  m_title(std::move(title)),
 	  m_escape_terminal_sequences(true),
 	  m_bold_counter(0),
@@ -533,6 +583,7 @@ Window::Window(const Window &rhs)
 , m_base_color(rhs.m_base_color)
 , m_border(rhs.m_border)
 , m_prompt_hook(rhs.m_prompt_hook)
+, m_prompt_hook_delay(rhs.m_prompt_hook_delay)
 , m_title(rhs.m_title)
 , m_color_stack(rhs.m_color_stack)
 , m_input_queue(rhs.m_input_queue)
@@ -557,6 +608,7 @@ Window::Window(Window &&rhs)
 , m_base_color(rhs.m_base_color)
 , m_border(rhs.m_border)
 , m_prompt_hook(rhs.m_prompt_hook)
+, m_prompt_hook_delay(rhs.m_prompt_hook_delay)
 , m_title(std::move(rhs.m_title))
 , m_color_stack(std::move(rhs.m_color_stack))
 , m_input_queue(std::move(rhs.m_input_queue))
@@ -582,6 +634,7 @@ Window &Window::operator=(Window rhs)
 	std::swap(m_base_color, rhs.m_base_color);
 	std::swap(m_border, rhs.m_border);
 	std::swap(m_prompt_hook, rhs.m_prompt_hook);
+	std::swap(m_prompt_hook_delay, rhs.m_prompt_hook_delay);
 	std::swap(m_title, rhs.m_title);
 	std::swap(m_color_stack, rhs.m_color_stack);
 	std::swap(m_input_queue, rhs.m_input_queue);
@@ -790,6 +843,15 @@ void Window::addFDCallback(int fd, void (*callback)())
 	m_fds.push_back(std::make_pair(fd, callback));
 }
 
+void Window::removeFDCallback(int fd)
+{
+	m_fds.erase(
+		std::remove_if(m_fds.begin(), m_fds.end(), [fd](const FDCallbacks::value_type &p) {
+			return p.first == fd;
+		}),
+		m_fds.end());
+}
+
 void Window::clearFDCallbacksList()
 {
 	m_fds.clear();
@@ -802,8 +864,53 @@ bool Window::FDCallbacksListEmpty() const
 
 Key::Type Window::getInputChar(int key)
 {
-	if (!m_escape_terminal_sequences || key != Key::Escape)
+	if (key != Key::Escape)
 		return key;
+	auto read_pasted_text = [this]() {
+		const std::string paste_end = "\e[201~";
+		m_pasted_text.clear();
+		// The rest of the text might not have arrived yet.
+		wtimeout(m_window, 100);
+		int x;
+		while ((x = wgetch(m_window)) != ERR)
+		{
+			m_pasted_text += x;
+			if (boost::algorithm::ends_with(m_pasted_text, paste_end))
+			{
+				m_pasted_text.resize(m_pasted_text.size() - paste_end.size());
+				break;
+			}
+		}
+		wtimeout(m_window, 0);
+		// The text is inserted into single line prompts, so get rid of line
+		// breaks and other control characters.
+		while (!m_pasted_text.empty()
+		       && (m_pasted_text.back() == '\n' || m_pasted_text.back() == '\r'))
+			m_pasted_text.pop_back();
+		std::replace_if(m_pasted_text.begin(), m_pasted_text.end(), [](char c) {
+				return static_cast<unsigned char>(c) < 32 || c == 127;
+			}, ' ');
+		return Key::Paste;
+	};
+	if (!m_escape_terminal_sequences)
+	{
+		// Readline handles escape sequences on its own, so only look for the
+		// beginning of pasted text and give back the characters otherwise.
+		const std::string paste_begin = "[200~";
+		for (size_t i = 0; i < paste_begin.size(); ++i)
+		{
+			int x = wgetch(m_window);
+			if (x != paste_begin[i])
+			{
+				for (size_t j = 0; j < i; ++j)
+					m_input_queue.push(paste_begin[j]);
+				if (x != ERR)
+					m_input_queue.push(x);
+				return key;
+			}
+		}
+		return read_pasted_text();
+	}
 	auto define_mouse_event = [this](int type) {
 		switch (type & ~28)
 		{
@@ -1064,6 +1171,8 @@ Key::Type Window::getInputChar(int key)
 					return Key::F11;
 				case 24:
 					return Key::F12;
+				case 200: // bracketed paste
+					return read_pasted_text();
 				default:
 					return Key::None;
 				}
@@ -1168,7 +1277,9 @@ Key::Type Window::readKey()
 		else
 			result = Key::None;
 
-		for (const auto &fd : m_fds)
+		// callbacks may modify the list, so don't iterate over it directly
+		auto fds = m_fds;
+		for (const auto &fd : fds)
 			if (FD_ISSET(fd.first, &fds_read))
 				fd.second();
 	}
@@ -1187,6 +1298,7 @@ std::string Window::prompt(const std::string &base, size_t width, bool encrypted
 	std::string result;
 
 	rl::aborted = false;
+	rl::hook_run = false;
 	rl::w = this;
 	getyx(m_window, rl::start_y, rl::start_x);
 	rl::width = std::min(m_width-rl::start_x-1, width-1);
@@ -125,6 +125,7 @@ const Type F11      = Special | 276;
 const Type F12      = Special | 277;
 const Type Mouse    = Special | 278;
 const Type EoF      = Special | 279;
+const Type Paste    = Special | 280;
 
 }
 
@@ -249,21 +250,26 @@ struct Window
 	/// @see Window::getString()
 	typedef std::function<bool(const char *)> PromptHook;
 
-	/// Sets helper to a specific value for the current scope
+	/// Sets helper to a specific value for the current scope. If delay (in
+	/// milliseconds) is given, helper is invoked only after the line wasn't
+	/// modified for that long instead of after each modification.
 	struct ScopedPromptHook
 	{
 		template <typename HelperT>
-		ScopedPromptHook(Window &w, HelperT &&helper) noexcept
-		: m_w(w), m_hook(std::move(w.m_prompt_hook)) {
+		ScopedPromptHook(Window &w, HelperT &&helper, int delay = 0) noexcept
+		: m_w(w), m_hook(std::move(w.m_prompt_hook)), m_delay(w.m_prompt_hook_delay) {
 			m_w.m_prompt_hook = std::forward<HelperT>(helper);
+			m_w.m_prompt_hook_delay = delay;
 		}
 		~ScopedPromptHook() noexcept {
 			m_w.m_prompt_hook = std::move(m_hook);
+			m_w.m_prompt_hook_delay = m_delay;
 		}
 
 	private:
 		Window &m_w;
 		PromptHook m_hook;
+		int m_delay;
 	};
 
 	struct ScopedTimeout
@@ -336,6 +342,13 @@ struct Window
 	/// @return current mouse event if readKey() returned KEY_MOUSE
 	const MEVENT &getMouseEvent();
 
+	/// @return text pasted into the terminal if readKey() returned Key::Paste
+	const std::string &getPastedText() const { return m_pasted_text; }
+
+	/// @return delay of the prompt hook
+	/// @see ScopedPromptHook
+	int getPromptHookDelay() const { return m_prompt_hook_delay; }
+
 	/// Reads the string from standard input using readline library.
 	/// @param base base string that has to be edited
 	/// @param length max length of the string, unlimited by default
@@ -430,6 +443,10 @@ struct Window
 	/// @param callback callback
 	void addFDCallback(int fd, void (*callback)());
 	
+	/// Removes given file descriptor from the list
+	/// @param fd file descriptor
+	void removeFDCallback(int fd);
+	
 	/// Clears list of file descriptors and their callbacks
 	void clearFDCallbacksList();
 	
@@ -536,6 +553,7 @@ private:
 	/// @see getString()
 	///
 	PromptHook m_prompt_hook;
+	int m_prompt_hook_delay;
 	
 	/// window title
 	std::string m_title;
@@ -555,6 +573,7 @@ private:
 	FDCallbacks m_fds;
 	
 	MEVENT m_mouse_event;
+	std::string m_pasted_text;
 	bool m_escape_terminal_sequences;
 
 	/// counters for format flags
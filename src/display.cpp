@@ -18,7 +18,10 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <boost/functional/hash.hpp>
 #include <cassert>
+#include <typeinfo>
+#include <unordered_map>
 
 #include "curses/menu_impl.h"
 #include "screens/browser.h"
@@ -76,6 +79,111 @@ const wchar_t *toColumnName(char c)
 	}
 }
 
+// Rows of song lists are rendered once and reused as long as they're drawn
+// the same way, so that redrawing a menu (e.g. when the highlighted position
+// changes) doesn't require evaluating formats or extracting tags again.
+struct RowKey
+{
+	bool operator==(const RowKey &rhs) const
+	{
+		return uri == rhs.uri
+			&& position == rhs.position
+			&& id == rhs.id
+			&& priority == rhs.priority
+			&& format == rhs.format
+			&& width == rhs.width
+			&& discard_colors == rhs.discard_colors;
+	}
+
+	// Identifies the record of the song (it's kept alive by the cached row).
+	const char *uri;
+	unsigned position;
+	unsigned id;
+	unsigned priority;
+	// Format or columns the row was rendered with.
+	const void *format;
+	int width;
+	bool discard_colors;
+};
+
+struct RowKeyHash
+{
+	size_t operator()(const RowKey &key) const
+	{
+		size_t seed = 0;
+		boost::hash_combine(seed, key.uri);
+		boost::hash_combine(seed, key.position);
+		boost::hash_combine(seed, key.id);
+		boost::hash_combine(seed, key.priority);
+		boost::hash_combine(seed, key.format);
+		boost::hash_combine(seed, key.width);
+		boost::hash_combine(seed, key.discard_colors);
+		return seed;
+	}
+};
+
+struct ColumnCell
+{
+	size_t column;
+	int width;
+	int x_offset;
+	bool separated;
+	std::wstring tag;
+};
+
+struct RenderedRow
+{
+	RenderedRow() : right_aligned_length(0) { }
+
+	MPD::Song song;
+
+	// Classic display mode.
+	NC::Buffer buffer;
+	NC::Buffer right_aligned;
+	size_t right_aligned_length;
+
+	// Columns display mode.
+	std::vector<ColumnCell> cells;
+};
+
+template <typename RenderT>
+const RenderedRow &renderRow(const NC::Window &menu, const MPD::Song &s,
+                             const void *format, int width, bool discard_colors,
+                             RenderT render)
+{
+	// Caches are never removed, but there are only as many of them as menus
+	// displaying songs. If the whole cache gets big, it's simply dropped.
+	const size_t max_rows = 1024;
+	static std::unordered_map<const NC::Window *,
+	                          std::unordered_map<RowKey, RenderedRow, RowKeyHash>> caches;
+	static RenderedRow uncached;
+
+	// Tags of songs of derived types (e.g. MutableSong) can change without
+	// their record being replaced, so they're not cached.
+	if (typeid(s) != typeid(MPD::Song))
+	{
+		uncached = RenderedRow();
+		render(uncached);
+		return uncached;
+	}
+
+	RowKey key = {
+		s.c_uri(), s.getPosition(), s.getID(), s.getPrio(), format, width, discard_colors
+	};
+	auto &rows = caches[&menu];
+	auto it = rows.find(key);
+	if (it == rows.end())
+	{
+		if (rows.size() >= max_rows)
+			rows.clear();
+		RenderedRow row;
+		row.song = s;
+		render(row);
+		it = rows.emplace(key, std::move(row)).first;
+	}
+	return it->second;
+}
+
 template <typename T>
 void setProperties(NC::Menu<T> &menu, const MPD::Song &s, const SongList &list,
                    bool &separate_albums, bool &is_now_playing, bool &is_selected,
@@ -142,13 +250,16 @@ void showSongs(NC::Menu<T> &menu, const MPD::Song &s, const SongList &list, cons
 	              is_in_playlist, discard_colors);
 
 	const size_t y = menu.getY();
-	NC::Buffer right_aligned;
-	Format::print(ast, menu, &s, &right_aligned,
-		discard_colors ? Format::Flags::Tag | Format::Flags::OutputSwitch : Format::Flags::All
-	);
-	if (!right_aligned.str().empty())
+	const auto &row = renderRow(menu, s, &ast, 0, discard_colors, [&](RenderedRow &r) {
+		Format::print(ast, r.buffer, &s, &r.right_aligned,
+			discard_colors ? Format::Flags::Tag | Format::Flags::OutputSwitch : Format::Flags::All
+		);
+		r.right_aligned_length = wideLength(ToWString(r.right_aligned.str()));
+	});
+	menu << row.buffer;
+	if (!row.right_aligned.str().empty())
 	{
-		size_t x_off = menu.getWidth() - wideLength(ToWString(right_aligned.str()));
+		size_t x_off = menu.getWidth() - row.right_aligned_length;
 		if (menu.isHighlighted() && list.currentS()->song() == &s)
 		{
 			if (menu.highlightSuffix() == Config.current_item_suffix)
@@ -160,7 +271,7 @@ void showSongs(NC::Menu<T> &menu, const MPD::Song &s, const SongList &list, cons
 			x_off -= Config.now_playing_suffix_length;
 		if (is_selected)
 			x_off -= Config.selected_item_suffix_length;
-		menu << NC::TermManip::ClearToEOL << NC::XY(x_off, y) << right_aligned;
+		menu << NC::TermManip::ClearToEOL << NC::XY(x_off, y) << row.right_aligned;
 	}
 
 	unsetProperties(menu, separate_albums, is_now_playing, is_in_playlist);
@@ -200,67 +311,85 @@ void showSongsInColumns(NC::Menu<T> &menu, const MPD::Song &s, const SongList &l
 		menu_width -= Config.selected_item_suffix_length;
 	}
 
-	int width;
-	int y = menu.getY();
-	int remained_width = menu_width;
+	const auto &row = renderRow(menu, s, &Config.columns, menu_width, false, [&](RenderedRow &r) {
+		int width;
+		int remained_width = menu_width;
 
-	std::vector<Column>::const_iterator it, last = Config.columns.end() - 1;
-	for (it = Config.columns.begin(); it != Config.columns.end(); ++it)
-	{
-		// check current X coordinate
-		int x = menu.getX();
-		// column has relative width and all after it have fixed width,
-		// so stretch it so it fills whole screen along with these after.
-		if (it->stretch_limit >= 0) // (*)
-			width = remained_width - it->stretch_limit;
-		else
-			width = it->fixed ? it->width : it->width * menu_width * 0.01;
-		// columns with relative width may shrink to 0, omit them
-		if (width == 0)
-			continue;
-		// if column is not last, we need to have spacing between it
-		// and next column, so we substract it now and restore later.
-		if (it != last)
-			--width;
-
-		// if column doesn't fit into screen, discard it and any other after it.
-		if (remained_width-width < 0 || width < 0 /* this one may come from (*) */)
-			break;
-
-		std::wstring tag;
-		for (size_t i = 0; i < it->type.length(); ++i)
+		std::string buffer;
+		std::vector<Column>::const_iterator it, last = Config.columns.end() - 1;
+		for (it = Config.columns.begin(); it != Config.columns.end(); ++it)
 		{
-			MPD::Song::GetFunction get = charToGetFunction(it->type[i]);
-			assert(get);
-			tag = ToWString(Charset::utf8ToLocale(s.getTags(get)));
-			if (!tag.empty())
+			// column has relative width and all after it have fixed width,
+			// so stretch it so it fills whole screen along with these after.
+			if (it->stretch_limit >= 0) // (*)
+				width = remained_width - it->stretch_limit;
+			else
+				width = it->fixed ? it->width : it->width * menu_width * 0.01;
+			// columns with relative width may shrink to 0, omit them
+			if (width == 0)
+				continue;
+			// if column is not last, we need to have spacing between it
+			// and next column, so we substract it now and restore later.
+			if (it != last)
+				--width;
+
+			// if column doesn't fit into screen, discard it and any other after it.
+			if (remained_width-width < 0 || width < 0 /* this one may come from (*) */)
 				break;
-		}
-		if (tag.empty() && it->display_empty_tag)
-			tag = ToWString(Config.empty_tag);
-		wideCut(tag, width);
 
-		if (!discard_colors && it->color != NC::Color::Default)
-			menu << it->color;
+			std::wstring tag;
+			for (size_t i = 0; i < it->type.length(); ++i)
+			{
+				MPD::Song::GetFunction get = charToGetFunction(it->type[i]);
+				assert(get);
+				auto value = s.getTagsRef(get, buffer);
+				if (!Config.system_encoding.empty())
+				{
+					buffer = Charset::utf8ToLocale(value.to_string());
+					value = buffer;
+				}
+				tag = convertString<wchar_t, char>::apply(value);
+				if (!tag.empty())
+					break;
+			}
+			if (tag.empty() && it->display_empty_tag)
+				tag = ToWString(Config.empty_tag);
+			wideCut(tag, width);
 
-		int x_off = 0;
-		// if column uses right alignment, calculate proper offset.
-		// otherwise just assume offset is 0, ie. we start from the left.
-		if (it->right_alignment)
-			x_off = std::max(0, width - int(wideLength(tag)));
+			int x_off = 0;
+			// if column uses right alignment, calculate proper offset.
+			// otherwise just assume offset is 0, ie. we start from the left.
+			if (it->right_alignment)
+				x_off = std::max(0, width - int(wideLength(tag)));
 
-		whline(menu.raw(), NC::Key::Space, width);
-		menu.goToXY(x + x_off, y);
-		menu << tag;
-		menu.goToXY(x + width, y);
-		if (it != last)
-		{
 			// add missing width's part and restore the value.
-			menu << ' ';
-			remained_width -= width+1;
+			if (it != last)
+				remained_width -= width+1;
+
+			r.cells.push_back(ColumnCell{
+				size_t(it - Config.columns.begin()), width, x_off, it != last, std::move(tag)
+			});
 		}
+	});
+
+	int y = menu.getY();
+	for (const auto &cell : row.cells)
+	{
+		const auto &column = Config.columns[cell.column];
+		// check current X coordinate
+		int x = menu.getX();
+
+		if (!discard_colors && column.color != NC::Color::Default)
+			menu << column.color;
+
+		whline(menu.raw(), NC::Key::Space, cell.width);
+		menu.goToXY(x + cell.x_offset, y);
+		menu << cell.tag;
+		menu.goToXY(x + cell.width, y);
+		if (cell.separated)
+			menu << ' ';
 
-		if (!discard_colors && it->color != NC::Color::Default)
+		if (!discard_colors && column.color != NC::Color::Default)
 			menu << NC::Color::End;
 	}
 
@@ -33,6 +33,39 @@ template <typename CharT> using string = std::basic_string<CharT>;
 template <typename CharT> using iterator = typename std::basic_string<CharT>::const_iterator;
 template <typename CharT> using expressions = std::vector<Format::Expression<CharT>>;
 
+template <typename CharT>
+struct TagTypesCollector : boost::static_visitor<void>
+{
+	TagTypesCollector(std::set<mpd_tag_type> &tags)
+	: m_tags(tags)
+	{ }
+
+	template <typename T>
+	void operator()(const T &) const { }
+
+	void operator()(const Format::SongTag &st) const
+	{
+		auto tag = getFunctionToTagType(st.function());
+		if (tag)
+			m_tags.insert(*tag);
+	}
+
+	void operator()(const Format::FirstOf<CharT> &first_of) const
+	{
+		for (const auto &ex : first_of.base())
+			boost::apply_visitor(*this, ex);
+	}
+
+	void operator()(const Format::Group<CharT> &group) const
+	{
+		for (const auto &ex : group.base())
+			boost::apply_visitor(*this, ex);
+	}
+
+private:
+	std::set<mpd_tag_type> &m_tags;
+};
+
 template <typename CharT>
 std::string invalidCharacter(CharT c)
 {
@@ -231,4 +264,16 @@ AST<wchar_t> parse(const std::wstring &s, const unsigned flags)
 	return AST<wchar_t>(parseBracket(s, s.begin(), s.end(), flags));
 }
 
+void tagTypes(const AST<char> &ast, std::set<mpd_tag_type> &tags)
+{
+	TagTypesCollector<char> collector(tags);
+	visit(collector, ast);
+}
+
+void tagTypes(const AST<wchar_t> &ast, std::set<mpd_tag_type> &tags)
+{
+	TagTypesCollector<wchar_t> collector(tags);
+	visit(collector, ast);
+}
+
 }
@@ -22,6 +22,7 @@
 #define NCMPCPP_HAVE_FORMAT_H
 
 #include <boost/variant.hpp>
+#include <set>
 
 #include "curses/menu.h"
 #include "song.h"
@@ -117,6 +118,11 @@ template <typename CharT>
 void print(const AST<CharT> &ast, NC::BasicBuffer<CharT> &buffer,
            const MPD::Song *song, const unsigned flags = Flags::All);
 
+template <typename CharT>
+void print(const AST<CharT> &ast, NC::BasicBuffer<CharT> &buffer,
+           const MPD::Song *song, NC::BasicBuffer<CharT> *second_buffer,
+           const unsigned flags = Flags::All);
+
 template <typename CharT>
 std::basic_string<CharT> stringify(const AST<CharT> &ast, const MPD::Song *song);
 
@@ -126,6 +132,10 @@ TagVector<CharT> flatten(const AST<CharT> &ast, const MPD::Song &song);
 AST<char> parse(const std::string &s, const unsigned flags = Flags::All);
 AST<wchar_t> parse(const std::wstring &ws, const unsigned flags = Flags::All);
 
+/// Inserts types of tags used by the format into the set.
+void tagTypes(const AST<char> &ast, std::set<mpd_tag_type> &tags);
+void tagTypes(const AST<wchar_t> &ast, std::set<mpd_tag_type> &tags);
+
 }
 
 #endif // NCMPCPP_HAVE_FORMAT_H
@@ -116,8 +116,9 @@ struct Printer: boost::static_visitor<Result>
 		StringT tags;
 		if (m_flags & Flags::Tag && m_song != nullptr)
 		{
+			std::string buffer;
 			tags = convertString<CharT, char>::apply(
-				m_song->getTags(st.function())
+				m_song->getTagsRef(st.function(), buffer)
 			);
 		}
 		if (!tags.empty())
@@ -276,6 +277,15 @@ void print(const AST<CharT> &ast, NC::BasicBuffer<CharT> &buffer,
 	visit(printer, ast);
 }
 
+template <typename CharT>
+void print(const AST<CharT> &ast, NC::BasicBuffer<CharT> &buffer,
+           const MPD::Song *song, NC::BasicBuffer<CharT> *second_buffer,
+           const unsigned flags)
+{
+	Printer<CharT, NC::BasicBuffer<CharT>> printer(buffer, song, second_buffer, flags);
+	visit(printer, ast);
+}
+
 template <typename CharT>
 std::basic_string<CharT> stringify(const AST<CharT> &ast, const MPD::Song *song)
 {
@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <algorithm>
+#include <numeric>
 #include <boost/range/adaptor/reversed.hpp>
 #include <time.h>
 
@@ -28,6 +29,74 @@
 #include "screens/playlist.h"
 #include "statusbar.h"
 #include "utility/functional.h"
+#include "utility/type_conversions.h"
+
+std::vector<mpd_tag_type> requiredTagTypes()
+{
+	// needed for grouping and sorting of songs, lyrics and streams
+	std::set<mpd_tag_type> tags = {
+		MPD_TAG_ARTIST,
+		MPD_TAG_ALBUM_ARTIST,
+		MPD_TAG_ALBUM,
+		MPD_TAG_TITLE,
+		MPD_TAG_TRACK,
+		MPD_TAG_DISC,
+		MPD_TAG_DATE,
+		MPD_TAG_NAME,
+		Config.media_lib_primary_tag
+	};
+	Format::tagTypes(Config.song_list_format, tags);
+	Format::tagTypes(Config.song_window_title_format, tags);
+	Format::tagTypes(Config.song_library_format, tags);
+	Format::tagTypes(Config.song_columns_mode_format, tags);
+	Format::tagTypes(Config.browser_sort_format, tags);
+	Format::tagTypes(Config.song_status_format, tags);
+	Format::tagTypes(Config.song_status_wformat, tags);
+	Format::tagTypes(Config.new_header_first_line, tags);
+	Format::tagTypes(Config.new_header_second_line, tags);
+	for (const auto &column : Config.columns)
+	{
+		for (char c : column.type)
+		{
+			auto tag = getFunctionToTagType(charToGetFunction(c));
+			if (tag)
+				tags.insert(*tag);
+		}
+	}
+	return std::vector<mpd_tag_type>(tags.begin(), tags.end());
+}
+
+void restrictTagTypes()
+{
+	if (Config.restrict_tag_types)
+		Mpd.SetEnabledTagTypes(requiredTagTypes());
+}
+
+bool isTagTypeEnabled(MPD::Song::GetFunction f)
+{
+	const auto &enabled = Mpd.GetEnabledTagTypes();
+	if (enabled.empty())
+		return true;
+	auto tag = getFunctionToTagType(f);
+	return !tag || std::binary_search(enabled.begin(), enabled.end(), *tag);
+}
+
+MPD::Song fetchAllTags(const MPD::Song &s)
+{
+	if (Mpd.GetEnabledTagTypes().empty() || !s.isFromDatabase() || s.isStream())
+		return s;
+	MPD::ScopedTagTypes all_tags(Mpd, {});
+	return Mpd.GetSong(s.getURI());
+}
+
+std::vector<MPD::Song> fetchPlaylistWithAllTags()
+{
+	std::vector<MPD::Song> result;
+	MPD::ScopedTagTypes all_tags(Mpd, {});
+	for (MPD::SongIterator s = Mpd.GetPlaylistChanges(0), end; s != end; ++s)
+		result.push_back(std::move(*s));
+	return result;
+}
 
 const MPD::Song *currentSong(const BaseScreen *screen)
 {
@@ -42,28 +111,162 @@ const MPD::Song *currentSong(const BaseScreen *screen)
 	return ptr;
 }
 
-void deleteSelectedSongsFromPlaylist(NC::Menu<MPD::Song> &playlist)
+std::vector<std::pair<unsigned, unsigned>> positionsToRanges(std::vector<unsigned> positions)
+{
+	std::vector<std::pair<unsigned, unsigned>> result;
+	std::sort(positions.begin(), positions.end());
+	for (auto pos : positions)
+	{
+		if (!result.empty() && result.back().second == pos)
+			++result.back().second;
+		else
+			result.emplace_back(pos, pos + 1);
+	}
+	return result;
+}
+
+size_t deleteSelectedSongsFromPlaylist(NC::Menu<MPD::Song> &playlist)
 {
 	selectCurrentIfNoneSelected(playlist);
-	boost::optional<int> range_end;
+	// Positions are taken from songs instead of menu indices, so that songs
+	// hidden by a filter are never included in a range.
+	std::vector<unsigned> positions;
+	for (auto pos : playlist.selectedPositions())
+	{
+		playlist.setSelected(pos, false);
+		positions.push_back(playlist[pos].value().getPosition());
+	}
+	auto ranges = positionsToRanges(std::move(positions));
+	// delete from the end so that positions of the remaining ranges stay valid
 	Mpd.StartCommandsList();
-	for (auto &s : boost::adaptors::reverse(playlist))
+	for (auto range = ranges.rbegin(); range != ranges.rend(); ++range)
+		Mpd.DeleteRange(range->first, range->second);
+	Mpd.CommitCommandsList();
+	return ranges.size();
+}
+
+namespace {
+
+// Marks elements that form the longest increasing subsequence of the sequence.
+std::vector<bool> longestIncreasingSubsequence(const std::vector<size_t> &seq, size_t &length)
+{
+	// tails[i] is the index of the smallest tail of increasing subsequences
+	// of length i+1, prev links elements of the subsequences.
+	std::vector<size_t> tails, prev(seq.size());
+	for (size_t i = 0; i < seq.size(); ++i)
+	{
+		auto it = std::lower_bound(tails.begin(), tails.end(), seq[i],
+			[&seq](size_t idx, size_t value) { return seq[idx] < value; });
+		prev[i] = it == tails.begin() ? -1 : *(it-1);
+		if (it == tails.end())
+			tails.push_back(i);
+		else
+			*it = i;
+	}
+	std::vector<bool> result(seq.size(), false);
+	length = tails.size();
+	if (!tails.empty())
+		for (size_t i = tails.back(); i != size_t(-1); i = prev[i])
+			result[i] = true;
+	return result;
+}
+
+}
+
+size_t reorderPlaylist(size_t start, const std::vector<size_t> &order)
+{
+	const size_t n = order.size();
+	// rank[i] is the target position of the song currently at position i
+	std::vector<size_t> rank(n);
+	for (size_t i = 0; i < n; ++i)
+		rank[order[i]] = i;
+
+	// Songs forming the longest increasing subsequence of ranks are already in
+	// the right relative order, so only the rest of them needs to be moved.
+	size_t fixed_count;
+	auto fixed = longestIncreasingSubsequence(rank, fixed_count);
+
+	// A permutation can also be applied with one swap less than its length for
+	// each of its cycles, which is better e.g. for reversing.
+	size_t swaps = n;
 	{
-		if (s.isSelected())
+		std::vector<bool> visited(n, false);
+		for (size_t i = 0; i < n; ++i)
 		{
-			s.setSelected(false);
-			if (range_end == boost::none)
-				range_end = s.value().getPosition() + 1;
+			if (visited[i])
+				continue;
+			--swaps;
+			for (size_t j = i; !visited[j]; j = order[j])
+				visited[j] = true;
 		}
-		else if (range_end != boost::none)
+	}
+
+	// current permutation and position of each song in it
+	std::vector<size_t> cur(n), where(n);
+	std::iota(cur.begin(), cur.end(), 0);
+	std::iota(where.begin(), where.end(), 0);
+	auto update_where = [&cur, &where](size_t first, size_t last) {
+		for (; first != last; ++first)
+			where[cur[first]] = first;
+	};
+
+	size_t commands = 0;
+	Mpd.StartCommandsList();
+	if (swaps <= n - fixed_count)
+	{
+		for (size_t k = 0; k < n; ++k)
 		{
-			Mpd.DeleteRange(s.value().getPosition() + 1, *range_end);
-			range_end.reset();
+			if (cur[k] == order[k])
+				continue;
+			size_t j = where[order[k]];
+			Mpd.Swap(start+k, start+j);
+			std::swap(cur[k], cur[j]);
+			where[cur[k]] = k;
+			where[cur[j]] = j;
+			++commands;
+		}
+	}
+	else
+	{
+		// Go through the songs in the target order and put each run of songs
+		// that need to be moved right after their predecessor in that order.
+		for (size_t k = 0; k < n;)
+		{
+			if (fixed[order[k]])
+			{
+				++k;
+				continue;
+			}
+			size_t j = where[order[k]], len = 1;
+			while (k+len < n
+			       && !fixed[order[k+len]]
+			       && j+len < n
+			       && cur[j+len] == order[k+len])
+				++len;
+			size_t pred_end = k == 0 ? 0 : where[order[k-1]] + 1;
+			if (j != pred_end)
+			{
+				size_t to;
+				if (j > pred_end)
+				{
+					to = pred_end;
+					std::rotate(cur.begin()+to, cur.begin()+j, cur.begin()+j+len);
+					update_where(to, j+len);
+				}
+				else
+				{
+					to = pred_end - len;
+					std::rotate(cur.begin()+j, cur.begin()+j+len, cur.begin()+pred_end);
+					update_where(j, pred_end);
+				}
+				Mpd.MoveRange(start+j, start+j+len, start+to);
+				++commands;
+			}
+			k += len;
 		}
 	}
-	if (range_end != boost::none)
-		Mpd.DeleteRange(0, *range_end);
 	Mpd.CommitCommandsList();
+	return commands;
 }
 
 void removeSongFromPlaylist(const SongMenu &playlist, const MPD::Song &s)
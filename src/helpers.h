@@ -134,22 +134,14 @@ bool search(NC::Menu<ItemT> &m, const PredicateT &pred,
 	return result;
 }
 
-template <typename Iterator>
-bool hasSelected(Iterator first, Iterator last)
-{
-	for (; first != last; ++first)
-		if (first->isSelected())
-			return true;
-	return false;
-}
-
-template <typename Iterator>
-std::vector<Iterator> getSelected(Iterator first, Iterator last)
+template <typename T>
+std::vector<typename NC::Menu<T>::Iterator> getSelected(NC::Menu<T> &m)
 {
-	std::vector<Iterator> result;
-	for (; first != last; ++first)
-		if (first->isSelected())
-			result.push_back(first);
+	std::vector<typename NC::Menu<T>::Iterator> result;
+	auto positions = m.selectedPositions();
+	result.reserve(positions.size());
+	for (auto pos : positions)
+		result.push_back(m.begin() + pos);
 	return result;
 }
 
@@ -205,92 +197,97 @@ bool findSelectedRange(Iterator &first, Iterator &last)
 template <typename T>
 void selectCurrentIfNoneSelected(NC::Menu<T> &m)
 {
-	if (!hasSelected(m.begin(), m.end()))
-		m.current()->setSelected(true);
+	if (!m.hasSelected())
+		m.setSelected(m.choice(), true);
 }
 
-template <typename Iterator>
-std::vector<Iterator> getSelectedOrCurrent(Iterator first, Iterator last, Iterator current)
+template <typename T>
+std::vector<typename NC::Menu<T>::Iterator> getSelectedOrCurrent(NC::Menu<T> &m)
 {
-	std::vector<Iterator> result = getSelected(first, last);
+	auto result = getSelected(m);
 	if (result.empty())
-		result.push_back(current);
+		result.push_back(m.current());
 	return result;
 }
 
+/// Splits positions into ranges [begin, end) of consecutive positions.
+/// @return ranges sorted in ascending order
+std::vector<std::pair<unsigned, unsigned>> positionsToRanges(std::vector<unsigned> positions);
+
 template <typename Iterator>
-void reverseSelectionHelper(Iterator first, Iterator last)
+std::vector<std::pair<unsigned, unsigned>> selectedRanges(const std::vector<Iterator> &list, Iterator begin)
 {
-	for (; first != last; ++first)
-		first->setSelected(!first->isSelected());
+	std::vector<unsigned> positions;
+	positions.reserve(list.size());
+	for (const auto &it : list)
+		positions.push_back(it - begin);
+	return positionsToRanges(std::move(positions));
 }
 
 template <typename F>
-void moveSelectedItemsUp(NC::Menu<MPD::Song> &m, F swap_fun)
+void moveSelectedItemsUp(NC::Menu<MPD::Song> &m, F move_fun)
 {
 	if (m.choice() > 0)
 		selectCurrentIfNoneSelected(m);
-	auto list = getSelected(m.begin(), m.end());
+	auto list = getSelected(m);
 	auto begin = m.begin();
 	if (!list.empty() && list.front() != m.begin())
 	{
+		// moving the item preceding each run of selected items
+		// below it shifts the whole run up by one position.
+		auto ranges = selectedRanges(list, begin);
 		Mpd.StartCommandsList();
-		for (auto it = list.begin(); it != list.end(); ++it)
-			swap_fun(&Mpd, *it - begin, *it - begin - 1);
+		for (const auto &range : ranges)
+			move_fun(&Mpd, range.first - 1, range.second - 1);
 		Mpd.CommitCommandsList();
+		// update the menu right away, selection moves along with items.
+		for (const auto &range : ranges)
+			m.rotate(range.first - 1, range.first, range.second);
 		if (list.size() > 1)
-		{
-			for (auto it = list.begin(); it != list.end(); ++it)
-			{
-				(*it)->setSelected(false);
-				(*it-1)->setSelected(true);
-			}
 			m.highlight(list[(list.size())/2] - begin - 1);
-		}
 		else
 		{
 			// if we move only one item, do not select it. however, if single item
 			// was selected prior to move, it'll deselect it. oh well.
-			list[0]->setSelected(false);
+			m.setSelected(ranges[0].first - 1, false);
 			m.scroll(NC::Scroll::Up);
 		}
 	}
 }
 
 template <typename F>
-void moveSelectedItemsDown(NC::Menu<MPD::Song> &m, F swap_fun)
+void moveSelectedItemsDown(NC::Menu<MPD::Song> &m, F move_fun)
 {
 	if (m.choice() < m.size()-1)
 		selectCurrentIfNoneSelected(m);
-	auto list = getSelected(m.rbegin(), m.rend());
-	auto begin = m.begin() + 1; // reverse iterators add 1, so we need to cancel it
-	if (!list.empty() && list.front() != m.rbegin())
+	auto list = getSelected(m);
+	auto begin = m.begin();
+	if (!list.empty() && list.back() != m.end() - 1)
 	{
+		// moving the item following each run of selected items
+		// above it shifts the whole run down by one position.
+		auto ranges = selectedRanges(list, begin);
 		Mpd.StartCommandsList();
-		for (auto it = list.begin(); it != list.end(); ++it)
-			swap_fun(&Mpd, it->base() - begin, it->base() - begin + 1);
+		for (const auto &range : ranges)
+			move_fun(&Mpd, range.second, range.first);
 		Mpd.CommitCommandsList();
+		// update the menu right away, selection moves along with items.
+		for (const auto &range : ranges)
+			m.rotate(range.first, range.second, range.second + 1);
 		if (list.size() > 1)
-		{
-			for (auto it = list.begin(); it != list.end(); ++it)
-			{
-				(*it)->setSelected(false);
-				(*it-1)->setSelected(true);
-			}
-			m.highlight(list[(list.size())/2].base() - begin + 1);
-		}
+			m.highlight(list[(list.size())/2] - begin + 1);
 		else
 		{
 			// if we move only one item, do not select it. however, if single item
 			// was selected prior to move, it'll deselect it. oh well.
-			list[0]->setSelected(false);
+			m.setSelected(ranges[0].first + 1, false);
 			m.scroll(NC::Scroll::Down);
 		}
 	}
 }
 
 template <typename F>
-void moveSelectedItemsTo(NC::Menu<MPD::Song> &menu, F &&move_fun)
+void moveSelectedItemsTo(NC::Menu<MPD::Song> &menu, F &&move_range_fun)
 {
 	auto cur_ptr = &menu.current()->value();
 	ScopedUnfilteredMenu<MPD::Song> sunfilter(ReapplyFilter::No, menu);
@@ -301,7 +298,7 @@ void moveSelectedItemsTo(NC::Menu<MPD::Song> &menu, F &&move_fun)
 		if (&it->value() == cur_ptr)
 			break;
 	auto begin = menu.begin();
-	auto list = getSelected(menu.begin(), menu.end());
+	auto list = getSelected(menu);
 	// we move only truly selected items
 	if (list.empty())
 		return;
@@ -309,79 +306,67 @@ void moveSelectedItemsTo(NC::Menu<MPD::Song> &menu, F &&move_fun)
 	//(this also handles case when list.size() == 1)
 	if (pos >= (list.front() - begin) && pos <= (list.back() - begin))
 		return;
+	// move whole runs of consecutive items at once, menu is updated the same
+	// way right away (selection and filtered items move along with items).
+	auto ranges = selectedRanges(list, begin);
 	int diff = pos - (list.front() - begin);
 	Mpd.StartCommandsList();
 	if (diff > 0) // move down
 	{
+		// start from the last run so that positions of the preceding ones
+		// stay the same.
 		pos -= list.size();
-		size_t i = list.size()-1;
-		for (auto it = list.rbegin(); it != list.rend(); ++it, --i)
-			move_fun(&Mpd, *it - begin, pos+i);
-		Mpd.CommitCommandsList();
-		i = list.size()-1;
-		for (auto it = list.rbegin(); it != list.rend(); ++it, --i)
+		size_t offset = list.size();
+		for (auto range = ranges.rbegin(); range != ranges.rend(); ++range)
 		{
-			(*it)->setSelected(false);
-			menu[pos+i].setSelected(true);
+			size_t length = range->second - range->first;
+			offset -= length;
+			move_range_fun(&Mpd, range->first, range->second, pos+offset);
+			menu.rotate(range->first, range->second, pos + offset + length);
 		}
 	}
 	else if (diff < 0) // move up
 	{
-		size_t i = 0;
-		for (auto it = list.begin(); it != list.end(); ++it, ++i)
-			move_fun(&Mpd, *it - begin, pos+i);
-		Mpd.CommitCommandsList();
-		i = 0;
-		for (auto it = list.begin(); it != list.end(); ++it, ++i)
+		size_t offset = 0;
+		for (const auto &range : ranges)
 		{
-			(*it)->setSelected(false);
-			menu[pos+i].setSelected(true);
+			move_range_fun(&Mpd, range.first, range.second, pos+offset);
+			menu.rotate(pos + offset, range.first, range.second);
+			offset += range.second - range.first;
 		}
 	}
+	Mpd.CommitCommandsList();
 }
 
+/// @return number of commands sent
 template <typename F>
-void deleteSelectedSongs(NC::Menu<MPD::Song> &menu, F &&delete_fun)
+size_t deleteSelectedSongs(NC::Menu<MPD::Song> &menu, F &&delete_fun)
 {
 	selectCurrentIfNoneSelected(menu);
-	// We need to operate on the whole playlist to get positions right, but at the
-	// same time we need to ignore all songs that are not filtered. We abuse the
-	// fact that both ranges share the same values, i.e. we can compare addresses
-	// of item values to check whether an item belongs to filtered range. TODO: do
-	// something more sane here.
-	NC::Menu<MPD::Song>::Iterator begin;
-	NC::Menu<MPD::Song>::ReverseIterator real_begin, real_end;
-	{
-		ScopedUnfilteredMenu<MPD::Song> sunfilter(ReapplyFilter::No, menu);
-		// obtain iterators for unfiltered range
-		begin = menu.begin() + 1; // cancel reverse iterator's offset
-		real_begin = menu.rbegin();
-		real_end = menu.rend();
-	};
-	// get iterator to filtered range
-	auto cur_filtered = menu.rbegin();
+	auto positions = menu.selectedPositions();
+	if (positions.empty())
+		return 0;
+	size_t commands = 0;
 	Mpd.StartCommandsList();
-	for (auto it = real_begin; it != real_end; ++it)
+	// Delete from the end so that positions of the remaining songs stay valid.
+	// We need positions of the songs in the whole playlist, but only the
+	// filtered ones are taken into account.
+	for (auto pos = positions.rbegin(); pos != positions.rend(); ++pos)
 	{
-		// current iterator belongs to filtered range, proceed
-		if (&it->value() == &cur_filtered->value())
-		{
-			if (it->isSelected())
-			{
-				it->setSelected(false);
-				delete_fun(Mpd, it.base() - begin);
-			}
-			++cur_filtered;
-		}
+		menu.setSelected(*pos, false);
+		delete_fun(Mpd, menu.unfilteredPosition(*pos));
+		++commands;
 	}
 	Mpd.CommitCommandsList();
+	return commands;
 }
 
+/// @return number of commands sent
 template <typename F>
-void cropPlaylist(NC::Menu<MPD::Song> &m, F delete_fun)
+size_t cropPlaylist(NC::Menu<MPD::Song> &m, F delete_fun)
 {
-	reverseSelectionHelper(m.begin(), m.end());
-	deleteSelectedSongs(m, delete_fun);
+	m.reverseSelection();
+	return deleteSelectedSongs(m, delete_fun);
 }
 
 template <typename Iterator>
@@ -402,47 +387,20 @@ template <typename Iterator>
 bool addSongsToPlaylist(Iterator first, Iterator last, bool play, int position)
 {
 	bool result = true;
-	auto addSongNoError = [&](Iterator it) -> int {
-		try
-		{
-			return Mpd.AddSong(*it, position);
-		}
-		catch (MPD::ServerError &e)
-		{
+	if (first == last)
+		return result;
+
+	auto ids = Mpd.AddSongs(std::vector<MPD::Song>(first, last), position,
+		[&result](MPD::ServerError &e) {
 			Status::handleServerError(e);
 			result = false;
-			return -1;
-		}
-	};
-
-	if (last-first >= 1)
+		});
+	if (play)
 	{
-		int id;
-		while (true)
-		{
-			id = addSongNoError(first);
-			if (id >= 0)
-				break;
-			++first;
-			if (first == last)
-				return result;
-		}
-
-		if (position == -1)
-		{
-			++first;
-			for(; first != last; ++first)
-				addSongNoError(first);
-		}
-		else
-		{
-			++position;
-			--last;
-			for (; first != last; --last)
-				addSongNoError(last);
-		}
-		if (play)
-			Mpd.PlayID(id);
+		// play the first song that was successfully added
+		auto id = std::find_if(ids.begin(), ids.end(), [](int i) { return i >= 0; });
+		if (id != ids.end())
+			Mpd.PlayID(*id);
 	}
 
 	return result;
@@ -528,10 +486,33 @@ inline const char *withErrors(bool success)
 	return success ? "" : " " "(with errors)";
 }
 
-void deleteSelectedSongsFromPlaylist(NC::Menu<MPD::Song> &playlist);
+/// Deletes selected songs from the main playlist, one command per each run
+/// of consecutive positions.
+/// @return number of commands sent
+size_t deleteSelectedSongsFromPlaylist(NC::Menu<MPD::Song> &playlist);
+
+/// Rearranges songs of the playlist at positions [start, start+order.size())
+/// so that the song at position start+order[i] ends up at start+i. Sends the
+/// smallest of the sequences of range moves or swaps it computes.
+/// @return number of commands sent
+size_t reorderPlaylist(size_t start, const std::vector<size_t> &order);
 
 bool addSongToPlaylist(const MPD::Song &s, bool play, int position = -1);
 
+/// Tags used by song formats, columns and other parts of the interface.
+std::vector<mpd_tag_type> requiredTagTypes();
+
+/// Makes MPD send only required tags if restrict_tag_types is enabled.
+void restrictTagTypes();
+
+/// @return true if values returned by the function are fetched from MPD
+bool isTagTypeEnabled(MPD::Song::GetFunction f);
+
+/// @return the song fetched again with all tags if tag types are restricted
+MPD::Song fetchAllTags(const MPD::Song &s);
+/// @return songs in the playlist with all tags
+std::vector<MPD::Song> fetchPlaylistWithAllTags();
+
 const MPD::Song *currentSong(const BaseScreen *screen);
 
 std::string timeFormat(const char *format, time_t t);
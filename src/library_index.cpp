@@ -0,0 +1,100 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "library_index.h"
+
+namespace {
+
+void addSong(LibraryIndex::Album &album, const MPD::Song &s)
+{
+	album.mtime = std::max(album.mtime, s.getMTime());
+	album.playtime += s.getDuration();
+	album.songs.push_back(s);
+}
+
+}
+
+LibraryIndex::LibraryIndex()
+: m_primary_tag(MPD_TAG_UNKNOWN), m_split_by_date(false), m_built(false)
+{ }
+
+void LibraryIndex::build(const std::vector<MPD::Song> &songs,
+                         mpd_tag_type primary_tag,
+                         bool split_by_date)
+{
+	clear();
+	for (const auto &s : songs)
+	{
+		auto key = AlbumKey(s.getAlbum(), split_by_date ? s.getDate() : "");
+		std::string tag;
+		for (unsigned idx = 0; !(tag = s.get(primary_tag, idx)).empty(); ++idx)
+		{
+			auto &entry = m_tags[std::move(tag)];
+			entry.mtime = std::max(entry.mtime, s.getMTime());
+			++entry.songs;
+			entry.playtime += s.getDuration();
+			addSong(entry.albums[key], s);
+		}
+		addSong(m_albums[std::move(key)], s);
+	}
+	m_primary_tag = primary_tag;
+	m_split_by_date = split_by_date;
+	m_built = true;
+}
+
+void LibraryIndex::clear()
+{
+	m_tags.clear();
+	m_albums.clear();
+	m_built = false;
+}
+
+bool LibraryIndex::builtWith(mpd_tag_type primary_tag, bool split_by_date) const
+{
+	return m_built
+		&& m_primary_tag == primary_tag
+		&& m_split_by_date == split_by_date;
+}
+
+const LibraryIndex::Tag *LibraryIndex::findTag(const std::string &tag) const
+{
+	auto it = m_tags.find(tag);
+	return it != m_tags.end() ? &it->second : nullptr;
+}
+
+const LibraryIndex::Album *LibraryIndex::findAlbum(const std::string &tag,
+                                                   const std::string &album,
+                                                   const std::string &date) const
+{
+	auto entry = findTag(tag);
+	if (entry == nullptr)
+		return nullptr;
+	auto it = entry->albums.find(AlbumKey(album, date));
+	return it != entry->albums.end() ? &it->second : nullptr;
+}
+
+const LibraryIndex::Album *LibraryIndex::findAlbum(const std::string &album,
+                                                   const std::string &date) const
+{
+	auto it = m_albums.find(AlbumKey(album, date));
+	return it != m_albums.end() ? &it->second : nullptr;
+}
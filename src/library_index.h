@@ -0,0 +1,90 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef NCMPCPP_LIBRARY_INDEX_H
+#define NCMPCPP_LIBRARY_INDEX_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "song.h"
+
+/// Songs from the database grouped by the primary tag of the media library
+/// and then by album (and date, if albums are split by date), so that media
+/// library columns can be browsed without querying the server.
+struct LibraryIndex
+{
+	struct Album
+	{
+		Album() : mtime(0), playtime(0) { }
+
+		time_t mtime;
+		unsigned long playtime;
+		std::vector<MPD::Song> songs;
+	};
+
+	/// Album name and date (empty if albums are not split by date).
+	typedef std::pair<std::string, std::string> AlbumKey;
+	typedef std::map<AlbumKey, Album> AlbumMap;
+
+	struct Tag
+	{
+		Tag() : mtime(0), songs(0), playtime(0) { }
+
+		time_t mtime;
+		unsigned songs;
+		unsigned long playtime;
+		AlbumMap albums;
+	};
+
+	typedef std::map<std::string, Tag> TagMap;
+
+	LibraryIndex();
+
+	void build(const std::vector<MPD::Song> &songs,
+	           mpd_tag_type primary_tag,
+	           bool split_by_date);
+	void clear();
+
+	/// @return true if the index was built with given grouping
+	bool builtWith(mpd_tag_type primary_tag, bool split_by_date) const;
+
+	/// Values of the primary tag, songs without it are omitted.
+	const TagMap &tags() const { return m_tags; }
+	/// All albums regardless of the primary tag.
+	const AlbumMap &albums() const { return m_albums; }
+
+	const Tag *findTag(const std::string &tag) const;
+	const Album *findAlbum(const std::string &tag,
+	                       const std::string &album,
+	                       const std::string &date) const;
+	const Album *findAlbum(const std::string &album,
+	                       const std::string &date) const;
+
+private:
+	TagMap m_tags;
+	AlbumMap m_albums;
+	mpd_tag_type m_primary_tag;
+	bool m_split_by_date;
+	bool m_built;
+};
+
+#endif // NCMPCPP_LIBRARY_INDEX_H
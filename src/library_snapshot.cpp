@@ -0,0 +1,362 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "library_snapshot.h"
+#include "mpdpp.h"
+#include "settings.h"
+
+LibrarySnapshot Library;
+
+namespace {
+
+const char snapshot_magic[] = "ncmpcpp library snapshot\n";
+const uint32_t snapshot_version = 1;
+
+// Names of song attributes, as understood by mpd_song_feed. They're stored in
+// the snapshot header and records refer to them by index, so that adding new
+// tags to libmpdclient doesn't invalidate already written snapshots.
+std::vector<std::string> attributeNames()
+{
+	std::vector<std::string> names = { "file", "Last-Modified", "Time" };
+	for (unsigned tag = 0; tag < MPD_TAG_COUNT; ++tag)
+	{
+		const char *name = mpd_tag_name(static_cast<mpd_tag_type>(tag));
+		names.push_back(name != nullptr ? name : "");
+	}
+	return names;
+}
+
+std::string lastModified(time_t t)
+{
+	char result[32];
+	tm tinfo;
+	gmtime_r(&t, &tinfo);
+	strftime(result, sizeof(result), "%Y-%m-%dT%H:%M:%SZ", &tinfo);
+	return result;
+}
+
+template <typename IntT>
+void writeInt(std::ostream &f, IntT value)
+{
+	f.write(reinterpret_cast<const char *>(&value), sizeof(IntT));
+}
+
+void writeString(std::ostream &f, const std::string &s)
+{
+	writeInt<uint32_t>(f, s.size());
+	// Strings are null terminated so that they can be passed to libmpdclient
+	// straight from the mapped file.
+	f.write(s.c_str(), s.size() + 1);
+}
+
+struct Reader
+{
+	Reader(const char *data, size_t size)
+	: m_pos(data), m_end(data + size)
+	{ }
+
+	template <typename IntT>
+	bool readInt(IntT &value)
+	{
+		if (m_end - m_pos < static_cast<ptrdiff_t>(sizeof(IntT)))
+			return false;
+		memcpy(&value, m_pos, sizeof(IntT));
+		m_pos += sizeof(IntT);
+		return true;
+	}
+
+	bool readString(const char *&s, uint32_t &length)
+	{
+		if (!readInt(length) || static_cast<size_t>(m_end - m_pos) <= length)
+			return false;
+		s = m_pos;
+		m_pos += length + 1;
+		return s[length] == '\0';
+	}
+
+	bool skip(const char *s, size_t length)
+	{
+		if (static_cast<size_t>(m_end - m_pos) < length
+		    || memcmp(m_pos, s, length) != 0)
+			return false;
+		m_pos += length;
+		return true;
+	}
+
+	size_t remaining() const
+	{
+		return m_end - m_pos;
+	}
+
+private:
+	const char *m_pos;
+	const char *m_end;
+};
+
+struct MappedFile
+{
+	MappedFile(const std::string &path)
+	: m_data(MAP_FAILED), m_size(0)
+	{
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0)
+		{
+			m_size = st.st_size;
+			m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+	}
+
+	~MappedFile()
+	{
+		if (m_data != MAP_FAILED)
+			munmap(m_data, m_size);
+	}
+
+	const char *data() const
+	{
+		return m_data != MAP_FAILED ? static_cast<const char *>(m_data) : nullptr;
+	}
+	size_t size() const { return m_size; }
+
+private:
+	void *m_data;
+	size_t m_size;
+};
+
+}
+
+LibrarySnapshot::LibrarySnapshot()
+: m_port(0), m_db_update_time(0), m_validated(false)
+{ }
+
+const std::vector<MPD::Song> &LibrarySnapshot::songs()
+{
+	if (m_validated)
+		return m_songs;
+
+	if (m_host != Mpd.GetHostname() || m_port != Mpd.GetPort())
+		clear();
+
+	// Servers that don't report database update time (e.g. proxies) don't let
+	// us tell whether anything changed, so the library has to be fetched.
+	unsigned long db_update_time = Mpd.getStatistics().dbUpdateTime();
+	if (db_update_time == 0 || db_update_time != m_db_update_time)
+	{
+		m_index.clear();
+		m_trigrams.clear();
+		std::string snapshot_path = path();
+		if (db_update_time == 0
+		    || snapshot_path.empty()
+		    || !load(snapshot_path, db_update_time))
+		{
+			fetch();
+			if (db_update_time != 0 && !snapshot_path.empty())
+				save(snapshot_path, db_update_time);
+		}
+		m_host = Mpd.GetHostname();
+		m_port = Mpd.GetPort();
+		m_db_update_time = db_update_time;
+	}
+	m_validated = true;
+	return m_songs;
+}
+
+const LibraryIndex &LibrarySnapshot::index()
+{
+	const auto &all_songs = songs();
+	if (!m_index.builtWith(Config.media_lib_primary_tag,
+	                       Config.media_library_albums_split_by_date))
+		m_index.build(all_songs,
+		              Config.media_lib_primary_tag,
+		              Config.media_library_albums_split_by_date);
+	return m_index;
+}
+
+const TrigramIndex &LibrarySnapshot::trigrams(const TrigramIndex::TagList &tags,
+                                              bool strip_diacritics)
+{
+	const auto &all_songs = songs();
+	if (!m_trigrams.builtWith(tags, strip_diacritics))
+		m_trigrams.build(all_songs, tags, strip_diacritics);
+	return m_trigrams;
+}
+
+void LibrarySnapshot::clear()
+{
+	m_songs.clear();
+	m_songs.shrink_to_fit();
+	m_index.clear();
+	m_trigrams.clear();
+	m_host.clear();
+	m_port = 0;
+	m_db_update_time = 0;
+	m_validated = false;
+}
+
+std::string LibrarySnapshot::path() const
+{
+	std::string result;
+	if (Config.library_snapshot)
+		result = Config.ncmpcpp_directory + "library_snapshot";
+	return result;
+}
+
+void LibrarySnapshot::fetch()
+{
+	m_songs.clear();
+	// snapshot is shared between screens, so it needs all tags
+	MPD::ScopedTagTypes all_tags(Mpd, {});
+	MPD::SongIterator s = Mpd.GetDirectoryRecursive("/"), end;
+	for (; s != end; ++s)
+		m_songs.push_back(std::move(*s));
+}
+
+bool LibrarySnapshot::load(const std::string &path, unsigned long db_update_time)
+{
+	MappedFile file(path);
+	if (file.data() == nullptr)
+		return false;
+	Reader r(file.data(), file.size());
+
+	uint32_t version, port, names_count, songs_count, length;
+	uint64_t update_time;
+	const char *host;
+	if (!r.skip(snapshot_magic, sizeof(snapshot_magic) - 1)
+	    || !r.readInt(version) || version != snapshot_version
+	    || !r.readInt(update_time) || update_time != db_update_time
+	    || !r.readString(host, length) || Mpd.GetHostname() != host
+	    || !r.readInt(port) || static_cast<int>(port) != Mpd.GetPort()
+	    || !r.readInt(names_count))
+		return false;
+	// Each name takes at least its length and the terminating null character,
+	// the first one is the name of the uri (which every song has).
+	const size_t min_name_size = sizeof(uint32_t) + 1;
+	if (names_count == 0 || names_count > r.remaining() / min_name_size)
+		return false;
+
+	std::vector<const char *> names(names_count);
+	for (auto &name : names)
+		if (!r.readString(name, length))
+			return false;
+
+	// Each song takes at least the number of its pairs and the uri.
+	const size_t min_song_size = 2*sizeof(uint32_t) + min_name_size;
+	if (!r.readInt(songs_count) || songs_count > r.remaining() / min_song_size)
+		return false;
+	std::vector<MPD::Song> songs;
+	songs.reserve(songs_count);
+	for (uint32_t i = 0; i < songs_count; ++i)
+	{
+		uint32_t pairs_count, name_idx;
+		mpd_pair pair;
+		// First pair is always the uri.
+		if (!r.readInt(pairs_count) || pairs_count == 0
+		    || !r.readInt(name_idx) || name_idx != 0
+		    || !r.readString(pair.value, length))
+			return false;
+		pair.name = names[0];
+		mpd_song *s = mpd_song_begin(&pair);
+		if (s == nullptr)
+			return false;
+		for (uint32_t j = 1; j < pairs_count; ++j)
+		{
+			if (!r.readInt(name_idx) || name_idx >= names.size()
+			    || !r.readString(pair.value, length))
+			{
+				mpd_song_free(s);
+				return false;
+			}
+			pair.name = names[name_idx];
+			mpd_song_feed(s, &pair);
+		}
+		// Song takes the contents of the complete mpd_song and frees it.
+		songs.push_back(MPD::Song(s));
+	}
+	m_songs = std::move(songs);
+	return true;
+}
+
+bool LibrarySnapshot::save(const std::string &path, unsigned long db_update_time) const
+{
+	// Write to a temporary file first so that an interrupted write doesn't
+	// leave a corrupted snapshot behind.
+	std::string tmp_path = path + ".tmp";
+	std::ofstream f(tmp_path, std::ios::binary | std::ios::trunc);
+	if (!f.is_open())
+		return false;
+
+	f.write(snapshot_magic, sizeof(snapshot_magic) - 1);
+	writeInt<uint32_t>(f, snapshot_version);
+	writeInt<uint64_t>(f, db_update_time);
+	writeString(f, Mpd.GetHostname());
+	writeInt<uint32_t>(f, Mpd.GetPort());
+	auto names = attributeNames();
+	writeInt<uint32_t>(f, names.size());
+	for (const auto &name : names)
+		writeString(f, name);
+
+	writeInt<uint32_t>(f, m_songs.size());
+	std::vector<std::pair<uint32_t, std::string>> pairs;
+	for (const auto &s : m_songs)
+	{
+		pairs.clear();
+		pairs.emplace_back(0, s.getURI());
+		if (s.getMTime() != 0)
+			pairs.emplace_back(1, lastModified(s.getMTime()));
+		if (s.getDuration() != 0)
+			pairs.emplace_back(2, std::to_string(s.getDuration()));
+		for (unsigned tag = 0; tag < MPD_TAG_COUNT; ++tag)
+		{
+			std::string value;
+			for (unsigned idx = 0;
+			     !(value = s.get(static_cast<mpd_tag_type>(tag), idx)).empty();
+			     ++idx)
+				pairs.emplace_back(tag + 3, std::move(value));
+		}
+		writeInt<uint32_t>(f, pairs.size());
+		for (const auto &pair : pairs)
+		{
+			writeInt<uint32_t>(f, pair.first);
+			writeString(f, pair.second);
+		}
+	}
+
+	f.close();
+	if (!f)
+	{
+		std::remove(tmp_path.c_str());
+		return false;
+	}
+	return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
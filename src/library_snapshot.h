@@ -0,0 +1,77 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef NCMPCPP_LIBRARY_SNAPSHOT_H
+#define NCMPCPP_LIBRARY_SNAPSHOT_H
+
+#include <string>
+#include <vector>
+
+#include "library_index.h"
+#include "song.h"
+#include "trigram_index.h"
+
+/// Local copy of the whole MPD database. It's fetched with a single
+/// listallinfo, persisted in ncmpcpp_directory and reused for as long as
+/// database update time reported by the server stays the same, so that
+/// consumers needing the whole library don't have to download it again.
+struct LibrarySnapshot
+{
+	LibrarySnapshot();
+
+	/// Returns all songs from the database, refetching them only if the
+	/// database changed since the snapshot was taken.
+	const std::vector<MPD::Song> &songs();
+
+	/// Returns songs grouped as configured for the media library. The index
+	/// is rebuilt only if the database or the grouping changed.
+	const LibraryIndex &index();
+
+	/// Returns trigram index of given tags of all songs. It's rebuilt only if
+	/// the database or the parameters changed.
+	const TrigramIndex &trigrams(const TrigramIndex::TagList &tags,
+	                             bool strip_diacritics);
+
+	/// Marks the snapshot as possibly outdated. It will be validated against
+	/// the server on next access.
+	void invalidate() { m_validated = false; }
+
+	/// Forgets everything kept in memory (the on-disk copy stays intact).
+	void clear();
+
+private:
+	bool load(const std::string &path, unsigned long db_update_time);
+	bool save(const std::string &path, unsigned long db_update_time) const;
+	void fetch();
+
+	std::string path() const;
+
+	std::vector<MPD::Song> m_songs;
+	LibraryIndex m_index;
+	TrigramIndex m_trigrams;
+	std::string m_host;
+	int m_port;
+	unsigned long m_db_update_time;
+	bool m_validated;
+};
+
+extern LibrarySnapshot Library;
+
+#endif // NCMPCPP_LIBRARY_SNAPSHOT_H
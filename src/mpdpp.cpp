@@ -20,14 +20,17 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <cstring>
 #include <algorithm>
 #include <map>
+#include <numeric>
 #include <boost/regex.hpp>
 
 #include "charset.h"
 #include "mpdpp.h"
 
 MPD::Connection Mpd;
+MPD::AsyncConnection MpdAsync(Mpd);
 
 namespace {
 
@@ -41,6 +44,15 @@ const char *mpdDirectory(const std::string &directory)
 		return directory.c_str();
 }
 
+std::string songPath(const MPD::Song &s)
+{
+	return (!s.isFromDatabase() ? "file://" : "") + s.getURI();
+}
+
+// MPD refuses command lists bigger than max_command_list_size (2 MB by default),
+// so the ones we send are limited to half of that.
+const size_t max_command_list_size = 1024 * 1024;
+
 template <typename ObjectT, typename SourceT>
 std::function<bool(typename MPD::Iterator<ObjectT>::State &)>
 defaultFetcher(SourceT *(fetcher)(mpd_connection *))
@@ -57,6 +69,29 @@ defaultFetcher(SourceT *(fetcher)(mpd_connection *))
 	};
 }
 
+// Makes the server send only given tags in song metadata (or all of them if
+// the list is empty). Needs MPD >= 0.21, with older ones it does nothing.
+void applyTagTypes(mpd_connection *conn, const std::vector<mpd_tag_type> &types)
+{
+#	if LIBMPDCLIENT_CHECK_VERSION(2, 12, 0)
+	const unsigned *version = mpd_connection_get_server_version(conn);
+	if (version[0] == 0 && version[1] < 21)
+		return;
+	if (types.empty())
+	{
+		mpd_send_command(conn, "tagtypes", "all", static_cast<const char *>(nullptr));
+		mpd_response_finish(conn);
+	}
+	else
+	{
+		mpd_run_clear_tag_types(conn);
+		MPD::checkConnectionErrors(conn);
+		mpd_run_enable_tag_types(conn, types.data(), types.size());
+	}
+	MPD::checkConnectionErrors(conn);
+#	endif // LIBMPDCLIENT_CHECK_VERSION(2, 12, 0)
+}
+
 bool fetchItemSong(MPD::SongIterator::State &state)
 {
 	auto src = mpd_recv_entity(state.connection());
@@ -115,6 +150,8 @@ void Connection::Connect()
 	{
 		m_connection.reset(mpd_connection_new(m_host.c_str(), m_port, m_timeout * 1000));
 		checkErrors();
+		// all tags are sent on a new connection
+		m_tag_types.clear();
 		if (!m_password.empty())
 			SendPassword();
 		m_fd = mpd_connection_get_fd(m_connection.get());
@@ -144,6 +181,17 @@ unsigned Connection::Version() const
 	return m_connection ? mpd_connection_get_server_version(m_connection.get())[1] : 0;
 }
 
+void Connection::SetEnabledTagTypes(std::vector<mpd_tag_type> types)
+{
+	prechecksNoCommandsList();
+	std::sort(types.begin(), types.end());
+	if (types != m_tag_types)
+	{
+		applyTagTypes(m_connection.get(), types);
+		m_tag_types = std::move(types);
+	}
+}
+
 void Connection::SetHostname(const std::string &host)
 {
 	size_t at = host.find("@");
@@ -290,6 +338,18 @@ void Connection::Move(unsigned from, unsigned to)
 	}
 }
 
+void Connection::MoveRange(unsigned start, unsigned end, unsigned to)
+{
+	prechecks();
+	if (m_command_list_active)
+		mpd_send_move_range(m_connection.get(), start, end, to);
+	else
+	{
+		mpd_run_move_range(m_connection.get(), start, end, to);
+		checkErrors();
+	}
+}
+
 void Connection::Swap(unsigned from, unsigned to)
 {
 	prechecks();
@@ -367,6 +427,21 @@ void Connection::PlaylistMove(const std::string &path, int from, int to)
 	}
 }
 
+void Connection::PlaylistMoveRange(const std::string &path, unsigned start, unsigned end, unsigned to)
+{
+	// stored playlists don't support moving ranges, move songs one by one.
+	if (to < start)
+	{
+		for (unsigned i = 0; i < end-start; ++i)
+			PlaylistMove(path, start+i, to+i);
+	}
+	else
+	{
+		for (unsigned i = end-start; i > 0; --i)
+			PlaylistMove(path, start+i-1, to+i-1);
+	}
+}
+
 void Connection::Rename(const std::string &from, const std::string &to)
 {
 	prechecksNoCommandsList();
@@ -543,6 +618,18 @@ void Connection::SetPriority(const Song &s, int prio)
 	}
 }
 
+void Connection::SetPriorityRange(unsigned start, unsigned end, int prio)
+{
+	prechecks();
+	if (m_command_list_active)
+		mpd_send_prio_range(m_connection.get(), prio, start, end);
+	else
+	{
+		mpd_run_prio_range(m_connection.get(), prio, start, end);
+		checkErrors();
+	}
+}
+
 int Connection::AddSong(const std::string &path, int pos)
 {
 	prechecks();
@@ -564,7 +651,64 @@ int Connection::AddSong(const std::string &path, int pos)
 
 int Connection::AddSong(const Song &s, int pos)
 {
-	return AddSong((!s.isFromDatabase() ? "file://" : "") + s.getURI(), pos);
+	return AddSong(songPath(s), pos);
+}
+
+std::vector<int> Connection::AddSongs(const std::vector<Song> &songs, int pos,
+                                      const ServerErrorHandler &error_handler)
+{
+	prechecksNoCommandsList();
+	std::vector<int> ids(songs.size(), -1);
+	size_t added = 0;
+	for (size_t first = 0; first < songs.size();)
+	{
+		// Send as many addid commands as fit into one command list.
+		size_t last = first, list_size = 0;
+		mpd_command_list_begin(m_connection.get(), true);
+		for (; last < songs.size() && list_size < max_command_list_size; ++last)
+		{
+			std::string path = songPath(songs[last]);
+			list_size += path.size() + 16;
+			if (pos < 0)
+				mpd_send_add_id(m_connection.get(), path.c_str());
+			else
+				mpd_send_add_id_to(m_connection.get(), path.c_str(), pos + added + (last - first));
+		}
+		mpd_command_list_end(m_connection.get());
+		checkErrors();
+
+		// Collect ids of added songs. MPD stops executing the command list at
+		// the first failing command, so report the error and resume after it.
+		for (; first < last; ++first)
+		{
+			int id = mpd_recv_song_id(m_connection.get());
+			if (mpd_connection_get_error(m_connection.get()) != MPD_ERROR_SUCCESS)
+				break;
+			ids[first] = id;
+			++added;
+			mpd_response_next(m_connection.get());
+		}
+		if (first < last)
+		{
+			try
+			{
+				checkErrors();
+			}
+			catch (ServerError &e)
+			{
+				if (!error_handler)
+					throw;
+				error_handler(e);
+			}
+			++first;
+		}
+		else
+		{
+			mpd_response_finish(m_connection.get());
+			checkErrors();
+		}
+	}
+	return ids;
 }
 
 bool Connection::Add(const std::string &path)
@@ -608,20 +752,11 @@ bool Connection::AddRandomTag(mpd_tag_type tag, size_t number, std::mt19937 &rng
 	return true;
 }
 
-bool Connection::AddRandomSongs(size_t number, const std::string &random_exclude_pattern, std::mt19937 &rng)
+bool Connection::AddRandomSongs(const std::vector<Song> &songs, size_t number,
+                                const std::string &random_exclude_pattern, std::mt19937 &rng)
 {
 	prechecksNoCommandsList();
-	std::vector<std::string> files;
-	mpd_send_list_all(m_connection.get(), "/");
-	while (mpd_pair *item = mpd_recv_pair_named(m_connection.get(), "file"))
-	{
-		files.push_back(item->value);
-		mpd_return_pair(m_connection.get(), item);
-	}
-	mpd_response_finish(m_connection.get());
-	checkErrors();
-	
-	if (number > files.size())
+	if (number > songs.size())
 	{
 		//if (itsErrorHandler)
 		//	itsErrorHandler(this, 0, "Requested number of random songs is bigger than size of your library", itsErrorHandlerUserdata);
@@ -629,13 +764,17 @@ bool Connection::AddRandomSongs(size_t number, const std::string &random_exclude
 	}
 	else
 	{
-		std::shuffle(files.begin(), files.end(), rng);
+		// Shuffle indices instead of the songs themselves as the list is shared.
+		std::vector<size_t> indices(songs.size());
+		std::iota(indices.begin(), indices.end(), 0);
+		std::shuffle(indices.begin(), indices.end(), rng);
 		StartCommandsList();
-		auto it = files.begin();
+		auto it = indices.begin();
 		boost::regex re(random_exclude_pattern);
-		for (size_t i = 0; i < number && it != files.end(); ++it) {
-			if (random_exclude_pattern.empty() || !boost::regex_match((*it), re)) {
-				AddSong(*it);
+		for (size_t i = 0; i < number && it != indices.end(); ++it) {
+			const char *uri = songs[*it].c_uri();
+			if (random_exclude_pattern.empty() || !boost::regex_match(uri, re)) {
+				AddSong(uri);
 				i++;
 			}
 		}
@@ -745,6 +884,98 @@ StringIterator Connection::GetList(mpd_tag_type type)
 	});
 }
 
+bool Connection::SupportsTagGroups() const
+{
+#	if LIBMPDCLIENT_CHECK_VERSION(2, 12, 0)
+	return Version() >= 21;
+#	else
+	return false;
+#	endif
+}
+
+TagGroupIterator Connection::GetGroupedList(mpd_tag_type type,
+                                            std::vector<mpd_tag_type> groups,
+                                            mpd_tag_type filter,
+                                            const std::string &value)
+{
+	prechecksNoCommandsList();
+	mpd_search_db_tags(m_connection.get(), type);
+	if (filter != MPD_TAG_UNKNOWN)
+		mpd_search_add_tag_constraint(m_connection.get(), MPD_OPERATOR_DEFAULT, filter, value.c_str());
+#	if LIBMPDCLIENT_CHECK_VERSION(2, 12, 0)
+	for (auto group : groups)
+		mpd_search_add_group_tag(m_connection.get(), group);
+#	endif
+	mpd_search_commit(m_connection.get());
+	checkErrors();
+	// Values of groups are sent only when they change, before values of type
+	// that belong to them, so remember the most recent ones.
+	std::vector<std::string> current(groups.size() + 1);
+	return TagGroupIterator(m_connection.get(),
+		[type, groups, current](TagGroupIterator::State &state) mutable {
+			while (mpd_pair *pair = mpd_recv_pair(state.connection()))
+			{
+				bool found = false;
+				mpd_tag_type tag = mpd_tag_name_iparse(pair->name);
+				if (tag == type)
+				{
+					current[0] = pair->value;
+					found = true;
+				}
+				else
+				{
+					auto it = std::find(groups.begin(), groups.end(), tag);
+					if (it != groups.end())
+						current[it - groups.begin() + 1] = pair->value;
+				}
+				mpd_return_pair(state.connection(), pair);
+				if (found)
+				{
+					state.setObject(current);
+					return true;
+				}
+			}
+			return false;
+		});
+}
+
+TagCountIterator Connection::GetTagCounts(mpd_tag_type group,
+                                          mpd_tag_type filter,
+                                          const std::string &value)
+{
+	prechecksNoCommandsList();
+	mpd_count_db_songs(m_connection.get());
+	if (filter != MPD_TAG_UNKNOWN)
+		mpd_search_add_tag_constraint(m_connection.get(), MPD_OPERATOR_DEFAULT, filter, value.c_str());
+#	if LIBMPDCLIENT_CHECK_VERSION(2, 12, 0)
+	mpd_search_add_group_tag(m_connection.get(), group);
+#	endif
+	mpd_search_commit(m_connection.get());
+	checkErrors();
+	return TagCountIterator(m_connection.get(), [group](TagCountIterator::State &state) {
+		// Each group consists of its value followed by songs and playtime.
+		std::string tag;
+		unsigned songs = 0;
+		while (mpd_pair *pair = mpd_recv_pair(state.connection()))
+		{
+			bool last = false;
+			if (mpd_tag_name_iparse(pair->name) == group)
+				tag = pair->value;
+			else if (strcmp(pair->name, "songs") == 0)
+				songs = strtoul(pair->value, nullptr, 10);
+			else if (strcmp(pair->name, "playtime") == 0)
+			{
+				state.setObject(TagCount(std::move(tag), songs, strtoul(pair->value, nullptr, 10)));
+				last = true;
+			}
+			mpd_return_pair(state.connection(), pair);
+			if (last)
+				return true;
+		}
+		return false;
+	});
+}
+
 void Connection::StartSearch(bool exact_match)
 {
 	prechecksNoCommandsList();
@@ -899,4 +1130,303 @@ void Connection::checkErrors() const
 	checkConnectionErrors(m_connection.get());
 }
 
+/*************************************************************************/
+
+AsyncConnection::AsyncConnection(Connection &main)
+: m_main(main)
+, m_async(nullptr)
+, m_fd(-1)
+, m_busy(false)
+, m_ignore_errors(false)
+, m_song(nullptr)
+{
+}
+
+void AsyncConnection::Connect()
+{
+	assert(!m_connection);
+	try
+	{
+		m_connection.reset(mpd_connection_new(m_main.GetHostname().c_str(),
+		                                      m_main.GetPort(),
+		                                      m_main.GetTimeout() * 1000));
+		checkConnectionErrors(m_connection.get());
+		if (!m_main.GetPassword().empty())
+		{
+			mpd_run_password(m_connection.get(), m_main.GetPassword().c_str());
+			checkConnectionErrors(m_connection.get());
+		}
+		m_tag_types.clear();
+	}
+	catch (MPD::ClientError &e)
+	{
+		m_connection = nullptr;
+		// Failure of this connection shouldn't affect the main one.
+		throw ClientError(e.code(), e.what(), true);
+	}
+	m_async = mpd_connection_get_async(m_connection.get());
+	m_fd = mpd_async_get_fd(m_async);
+	m_parser.reset(mpd_parser_new());
+	if (m_fd_callback)
+		m_fd_callback(m_fd, true);
+}
+
+bool AsyncConnection::Connected() const
+{
+	return m_connection.get() != nullptr;
+}
+
+void AsyncConnection::Disconnect()
+{
+	reset();
+	if (m_connection && m_fd_callback)
+		m_fd_callback(m_fd, false);
+	m_connection = nullptr;
+	m_parser = nullptr;
+	m_async = nullptr;
+	m_fd = -1;
+}
+
+void AsyncConnection::setFDCallback(FDCallback callback)
+{
+	m_fd_callback = std::move(callback);
+}
+
+void AsyncConnection::Cancel()
+{
+	// There is no way to abort the response, so drop the connection.
+	if (m_busy)
+		Disconnect();
+}
+
+void AsyncConnection::IgnoreErrors()
+{
+	if (m_busy)
+		m_ignore_errors = true;
+}
+
+void AsyncConnection::GetDirectoryRecursive(const std::string &directory,
+                                            SongsHandler on_songs, FinishHandler on_finish)
+{
+	startCommand("listallinfo");
+	appendArgument(mpdDirectory(directory));
+	sendCommand(std::move(on_songs), std::move(on_finish));
+}
+
+void AsyncConnection::GetPlaylistContent(const std::string &name,
+                                         SongsHandler on_songs, FinishHandler on_finish)
+{
+	startCommand("listplaylistinfo");
+	appendArgument(name.c_str());
+	sendCommand(std::move(on_songs), std::move(on_finish));
+}
+
+void AsyncConnection::StartSearch(bool exact_match)
+{
+	startCommand(exact_match ? "find" : "search");
+}
+
+void AsyncConnection::AddSearch(mpd_tag_type item, const std::string &str)
+{
+	appendArgument(mpd_tag_name(item));
+	appendArgument(str.c_str());
+}
+
+void AsyncConnection::AddSearchAny(const std::string &str)
+{
+	appendArgument("any");
+	appendArgument(str.c_str());
+}
+
+void AsyncConnection::AddSearchURI(const std::string &str)
+{
+	appendArgument("file");
+	appendArgument(str.c_str());
+}
+
+void AsyncConnection::CommitSearchSongs(SongsHandler on_songs, FinishHandler on_finish)
+{
+	sendCommand(std::move(on_songs), std::move(on_finish));
+}
+
+void AsyncConnection::process()
+{
+	// The request is reset before its error is thrown, so check beforehand
+	// whether the error should be passed on.
+	bool ignore_errors = m_ignore_errors;
+	try
+	{
+		processResponse();
+	}
+	catch (Error &)
+	{
+		if (!ignore_errors)
+			throw;
+	}
+}
+
+void AsyncConnection::processResponse()
+{
+	if (!m_connection)
+		return;
+	if (!mpd_async_io(m_async, MPD_ASYNC_EVENT_READ))
+	{
+		if (m_busy)
+			throwError();
+		// The server closed the connection because it was idle for too long,
+		// we'll reconnect with the next request.
+		Disconnect();
+		return;
+	}
+
+	bool finished = false;
+	char *line;
+	while (!finished && (line = mpd_async_recv_line(m_async)) != nullptr)
+	{
+		switch (mpd_parser_feed(m_parser.get(), line))
+		{
+			case MPD_PARSER_PAIR:
+			{
+				mpd_pair pair = {
+					mpd_parser_get_name(m_parser.get()),
+					mpd_parser_get_value(m_parser.get())
+				};
+				if (!strcmp(pair.name, "file"))
+				{
+					finishSong();
+					m_song = mpd_song_begin(&pair);
+				}
+				else if (!strcmp(pair.name, "directory") || !strcmp(pair.name, "playlist"))
+					finishSong();
+				else if (m_song != nullptr)
+					mpd_song_feed(m_song, &pair);
+				break;
+			}
+			case MPD_PARSER_SUCCESS:
+				finishSong();
+				finished = true;
+				break;
+			case MPD_PARSER_ERROR:
+			{
+				auto code = mpd_parser_get_server_error(m_parser.get());
+				std::string msg = mpd_parser_get_message(m_parser.get());
+				// The response is complete, so the connection is still usable.
+				finishRequest(false, false);
+				throw ServerError(code, msg, true);
+			}
+			case MPD_PARSER_MALFORMED:
+				finishRequest(false, true);
+				throw ClientError(MPD_ERROR_MALFORMED, "Malformed response from server", true);
+		}
+	}
+
+	if (!m_songs.empty())
+	{
+		std::vector<Song> songs;
+		songs.swap(m_songs);
+		if (m_on_songs)
+			m_on_songs(std::move(songs));
+	}
+	if (finished)
+		finishRequest(true, false);
+}
+
+void AsyncConnection::startCommand(const char *command)
+{
+	Cancel();
+	m_command = command;
+}
+
+void AsyncConnection::appendArgument(const char *arg)
+{
+	m_command += " \"";
+	for (; *arg != '\0'; ++arg)
+	{
+		if (*arg == '"' || *arg == '\\')
+			m_command += '\\';
+		m_command += *arg;
+	}
+	m_command += '"';
+}
+
+void AsyncConnection::sendCommand(SongsHandler on_songs, FinishHandler on_finish)
+{
+	if (!m_connection)
+		Connect();
+	// Nothing is in flight at this point, so tag types can be synchronized
+	// with the main connection synchronously.
+	if (m_tag_types != m_main.GetEnabledTagTypes())
+	{
+		try
+		{
+			applyTagTypes(m_connection.get(), m_main.GetEnabledTagTypes());
+		}
+		catch (MPD::ClientError &e)
+		{
+			Disconnect();
+			throw ClientError(e.code(), e.what(), true);
+		}
+		m_tag_types = m_main.GetEnabledTagTypes();
+	}
+	// Arguments are already quoted, so pass the whole line as a command.
+	if (!mpd_async_send_command(m_async, m_command.c_str(), static_cast<const char *>(nullptr)))
+		throwError();
+	while (mpd_async_events(m_async) & MPD_ASYNC_EVENT_WRITE)
+		if (!mpd_async_io(m_async, MPD_ASYNC_EVENT_WRITE))
+			throwError();
+	m_command.clear();
+	m_on_songs = std::move(on_songs);
+	m_on_finish = std::move(on_finish);
+	m_busy = true;
+}
+
+void AsyncConnection::finishSong()
+{
+	if (m_song != nullptr)
+	{
+		m_songs.push_back(Song(m_song));
+		m_song = nullptr;
+	}
+}
+
+void AsyncConnection::finishRequest(bool success, bool disconnect)
+{
+	// Handlers are dropped by reset, so the finish handler needs to be taken
+	// out beforehand.
+	auto on_finish = std::move(m_on_finish);
+	if (disconnect)
+		Disconnect();
+	else
+		reset();
+	if (on_finish)
+		on_finish(success);
+}
+
+void AsyncConnection::reset()
+{
+	if (m_song != nullptr)
+	{
+		mpd_song_free(m_song);
+		m_song = nullptr;
+	}
+	m_songs.clear();
+	m_command.clear();
+	m_on_songs = nullptr;
+	m_on_finish = nullptr;
+	m_busy = false;
+	m_ignore_errors = false;
+}
+
+void AsyncConnection::throwError()
+{
+	mpd_error code = mpd_async_get_error(m_async);
+	const char *msg = mpd_async_get_error_message(m_async);
+	ClientError e(code != MPD_ERROR_SUCCESS ? code : MPD_ERROR_CLOSED,
+	              msg != nullptr ? msg : "Connection closed by the server",
+	              true);
+	// Requests in flight end along with the connection.
+	finishRequest(false, true);
+	throw e;
+}
+
 }
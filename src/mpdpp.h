@@ -119,6 +119,7 @@ struct Status
 	int nextSongPosition() const { return mpd_status_get_next_song_pos(m_status.get()); }
 	int nextSongID() const { return mpd_status_get_next_song_id(m_status.get()); }
 	unsigned elapsedTime() const { return mpd_status_get_elapsed_time(m_status.get()); }
+	unsigned elapsedTimeMs() const { return mpd_status_get_elapsed_ms(m_status.get()); }
 	unsigned totalTime() const { return mpd_status_get_total_time(m_status.get()); }
 	unsigned kbps() const { return mpd_status_get_kbit_rate(m_status.get()); }
 	unsigned updateID() const { return mpd_status_get_update_id(m_status.get()); }
@@ -352,6 +353,23 @@ private:
 	std::shared_ptr<mpd_output> m_output;
 };
 
+/// Number of songs with a given value of a tag and their total duration.
+struct TagCount
+{
+	TagCount() : m_songs(0), m_playtime(0) { }
+	TagCount(std::string tag_, unsigned songs_, unsigned long playtime_)
+	: m_tag(std::move(tag_)), m_songs(songs_), m_playtime(playtime_) { }
+
+	const std::string &tag() const { return m_tag; }
+	unsigned songs() const { return m_songs; }
+	unsigned long playtime() const { return m_playtime; }
+
+private:
+	std::string m_tag;
+	unsigned m_songs;
+	unsigned long m_playtime;
+};
+
 template <typename ObjectT>
 struct Iterator: std::iterator<std::input_iterator_tag, ObjectT>
 {
@@ -484,10 +502,13 @@ typedef Iterator<Output> OutputIterator;
 typedef Iterator<Playlist> PlaylistIterator;
 typedef Iterator<Song> SongIterator;
 typedef Iterator<std::string> StringIterator;
+typedef Iterator<TagCount> TagCountIterator;
+typedef Iterator<std::vector<std::string>> TagGroupIterator;
 
 struct Connection
 {
 	typedef std::function<void(int)> NoidleCallback;
+	typedef std::function<void(ServerError &)> ServerErrorHandler;
 
 	Connection();
 	
@@ -497,10 +518,17 @@ struct Connection
 	
 	const std::string &GetHostname() { return m_host; }
 	int GetPort() { return m_port; }
+	int GetTimeout() const { return m_timeout; }
+	const std::string &GetPassword() const { return m_password; }
 	
 	unsigned Version() const;
 	
 	int GetFD() const { return m_fd; }
+
+	/// Makes the server send only given tags in song metadata (all of them
+	/// if the list is empty). Requires MPD >= 0.21, ignored otherwise.
+	void SetEnabledTagTypes(std::vector<mpd_tag_type> types);
+	const std::vector<mpd_tag_type> &GetEnabledTagTypes() const { return m_tag_types; }
 	
 	void SetHostname(const std::string &);
 	void SetPort(int port) { m_port = port; }
@@ -522,6 +550,7 @@ struct Connection
 	void Next();
 	void Prev();
 	void Move(unsigned int from, unsigned int to);
+	void MoveRange(unsigned start, unsigned end, unsigned to);
 	void Swap(unsigned, unsigned);
 	void Seek(unsigned int pos, unsigned int where);
 	void Shuffle();
@@ -549,11 +578,19 @@ struct Connection
 	void SetReplayGainMode(ReplayGainMode);
 	
 	void SetPriority(const MPD::Song &s, int prio);
+	void SetPriorityRange(unsigned start, unsigned end, int prio);
 	
 	int AddSong(const std::string &, int = -1); // returns id of added song
 	int AddSong(const Song &, int = -1); // returns id of added song
+	
+	/// Adds songs using pipelined command lists. Errors related to particular
+	/// songs are passed to the handler and the remaining songs are still added.
+	/// @return ids of added songs (-1 for songs that couldn't be added)
+	std::vector<int> AddSongs(const std::vector<Song> &songs, int pos,
+	                          const ServerErrorHandler &error_handler);
 	bool AddRandomTag(mpd_tag_type, size_t, std::mt19937 &rng);
-	bool AddRandomSongs(size_t number, const std::string &random_exclude_pattern, std::mt19937 &rng);
+	bool AddRandomSongs(const std::vector<Song> &songs, size_t number,
+	                    const std::string &random_exclude_pattern, std::mt19937 &rng);
 	bool Add(const std::string &path);
 	void Delete(unsigned int pos);
 	void DeleteRange(unsigned begin, unsigned end);
@@ -568,6 +605,7 @@ struct Connection
 	void AddToPlaylist(const std::string &, const Song &);
 	void AddToPlaylist(const std::string &, const std::string &);
 	void PlaylistMove(const std::string &path, int from, int to);
+	void PlaylistMoveRange(const std::string &path, unsigned start, unsigned end, unsigned to);
 	void Rename(const std::string &from, const std::string &to);
 	
 	void StartSearch(bool);
@@ -579,6 +617,21 @@ struct Connection
 	
 	PlaylistIterator GetPlaylists();
 	StringIterator GetList(mpd_tag_type type);
+
+	/// @return true if the server can group results of list and count
+	bool SupportsTagGroups() const;
+	/// Lists distinct values of a tag along with values of tags they are
+	/// grouped by, optionally only for songs with a given value of filter
+	/// tag. Each element contains value of type followed by group values.
+	TagGroupIterator GetGroupedList(mpd_tag_type type,
+	                                std::vector<mpd_tag_type> groups,
+	                                mpd_tag_type filter = MPD_TAG_UNKNOWN,
+	                                const std::string &value = "");
+	/// Counts songs and their total duration for each value of a tag,
+	/// optionally only for songs with a given value of filter tag.
+	TagCountIterator GetTagCounts(mpd_tag_type group,
+	                              mpd_tag_type filter = MPD_TAG_UNKNOWN,
+	                              const std::string &value = "");
 	ItemIterator GetDirectory(const std::string &directory);
 	SongIterator GetDirectoryRecursive(const std::string &directory);
 	SongIterator GetSongs(const std::string &directory);
@@ -614,14 +667,129 @@ private:
 	int m_fd;
 	bool m_idle;
 	
+	std::vector<mpd_tag_type> m_tag_types;
+
 	std::string m_host;
 	int m_port;
 	int m_timeout;
 	std::string m_password;
 };
 
+/// Secondary connection for requests that may return a lot of data. Commands
+/// are sent immediately, but responses are parsed incrementally whenever the
+/// socket becomes readable and handed over in batches, so that the main loop
+/// is not blocked while they're in flight.
+struct AsyncConnection
+{
+	typedef std::function<void(int, bool)> FDCallback;
+	typedef std::function<void(std::vector<Song> &&)> SongsHandler;
+	typedef std::function<void(bool)> FinishHandler;
+
+	/// @param main connection whose server parameters will be used
+	AsyncConnection(Connection &main);
+
+	void Connect();
+	bool Connected() const;
+	void Disconnect();
+
+	/// Set callback that is invoked with (fd, true) when the socket needs to be
+	/// watched for incoming data and with (fd, false) when it no longer does.
+	void setFDCallback(FDCallback callback);
+
+	/// Checks whether there is a response in flight.
+	bool Busy() const { return m_busy; }
+
+	/// Drops the request in flight (if any). Its handlers won't be called.
+	void Cancel();
+
+	/// Makes failure of the request in flight be reported only to its finish
+	/// handler, i.e. process won't throw the error.
+	void IgnoreErrors();
+
+	void GetDirectoryRecursive(const std::string &directory,
+	                           SongsHandler on_songs, FinishHandler on_finish);
+	void GetPlaylistContent(const std::string &name,
+	                        SongsHandler on_songs, FinishHandler on_finish);
+
+	void StartSearch(bool exact_match);
+	void AddSearch(mpd_tag_type item, const std::string &str);
+	void AddSearchAny(const std::string &str);
+	void AddSearchURI(const std::string &str);
+	void CommitSearchSongs(SongsHandler on_songs, FinishHandler on_finish);
+
+	/// Reads available data and passes parsed songs to the handler. Meant to
+	/// be called when the socket becomes readable. The finish handler is told
+	/// whether the request succeeded. If it failed, the handler is called
+	/// before the error is thrown.
+	void process();
+
+private:
+	struct ConnectionDeleter {
+		void operator()(mpd_connection *connection) {
+			mpd_connection_free(connection);
+		}
+	};
+	struct ParserDeleter {
+		void operator()(mpd_parser *parser) {
+			mpd_parser_free(parser);
+		}
+	};
+
+	void startCommand(const char *command);
+	void appendArgument(const char *arg);
+	void sendCommand(SongsHandler on_songs, FinishHandler on_finish);
+	void processResponse();
+	void finishSong();
+	void finishRequest(bool success, bool disconnect);
+	void reset();
+	void throwError();
+
+	Connection &m_main;
+	FDCallback m_fd_callback;
+	std::unique_ptr<mpd_connection, ConnectionDeleter> m_connection;
+	std::unique_ptr<mpd_parser, ParserDeleter> m_parser;
+	mpd_async *m_async;
+	int m_fd;
+	bool m_busy;
+	bool m_ignore_errors;
+
+	std::string m_command;
+	SongsHandler m_on_songs;
+	FinishHandler m_on_finish;
+	mpd_song *m_song;
+	std::vector<Song> m_songs;
+	std::vector<mpd_tag_type> m_tag_types;
+};
+
+/// Enables given tag types for the lifetime of the object and restores
+/// previously enabled ones afterwards.
+struct ScopedTagTypes
+{
+	ScopedTagTypes(Connection &connection, std::vector<mpd_tag_type> types)
+	: m_connection(connection), m_previous(connection.GetEnabledTagTypes())
+	{
+		m_connection.SetEnabledTagTypes(std::move(types));
+	}
+
+	~ScopedTagTypes()
+	{
+		try
+		{
+			m_connection.SetEnabledTagTypes(std::move(m_previous));
+		}
+		// Destructor can't throw. If the connection is gone, all tags will be
+		// enabled on the next one.
+		catch (MPD::Error &) { }
+	}
+
+private:
+	Connection &m_connection;
+	std::vector<mpd_tag_type> m_previous;
+};
+
 }
 
 extern MPD::Connection Mpd;
+extern MPD::AsyncConnection MpdAsync;
 
 #endif // NCMPCPP_MPDPP_H
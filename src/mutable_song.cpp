@@ -24,6 +24,18 @@
 
 namespace MPD {
 
+boost::string_ref MutableSong::getRef(GetFunction f, unsigned idx, std::string &buffer) const
+{
+	// modified values are not stored in the same place as original ones
+	if (isModified())
+	{
+		buffer = (this->*f)(idx);
+		return buffer;
+	}
+	else
+		return Song::getRef(f, idx, buffer);
+}
+
 std::string MutableSong::getArtist(unsigned idx) const
 {
 	return getTag(MPD_TAG_ARTIST, [this, idx](){ return Song::getArtist(idx); }, idx);
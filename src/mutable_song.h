@@ -45,6 +45,8 @@ struct MutableSong : public Song
 	virtual std::string getPerformer(unsigned idx = 0) const override;
 	virtual std::string getDisc(unsigned idx = 0) const override;
 	virtual std::string getComment(unsigned idx = 0) const override;
+
+	virtual boost::string_ref getRef(GetFunction f, unsigned idx, std::string &buffer) const override;
 	
 	void setArtist(const std::string &value, unsigned idx = 0);
 	void setTitle(const std::string &value, unsigned idx = 0);
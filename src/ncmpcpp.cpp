@@ -112,6 +112,12 @@ int main(int argc, char **argv)
 	signal(SIGWINCH, sighandler);
 
 	Mpd.setNoidleCallback(Status::update);
+	MpdAsync.setFDCallback([](int fd, bool watch) {
+		if (watch)
+			Global::wFooter->addFDCallback(fd, Statusbar::Helpers::mpdAsync);
+		else
+			Global::wFooter->removeFDCallback(fd);
+	});
 
 	NC::initScreen(Config.colors_enabled, Config.mouse_support);
 	
@@ -178,7 +184,8 @@ int main(int argc, char **argv)
 				connect_attempt = Timer;
 				// reset local status info
 				Status::clear();
-				// clear mpd callback
+				// clear mpd callbacks
+				MpdAsync.Disconnect();
 				wFooter->clearFDCallbacksList();
 				try
 				{
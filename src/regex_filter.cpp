@@ -0,0 +1,426 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#include "regex_filter.h"
+#include "utility/lru_cache.h"
+
+namespace {
+
+#ifdef BOOST_REGEX_ICU
+
+struct StripDiacritics
+{
+	static void convert(icu::UnicodeString &s)
+	{
+		// Transliterators can't be used by multiple threads at once.
+		thread_local std::unique_ptr<icu::Transliterator> converter;
+		if (converter == nullptr)
+		{
+			icu::ErrorCode result;
+			converter.reset(icu::Transliterator::createInstance(
+				"NFD; [:M:] Remove; NFC", UTRANS_FORWARD, result));
+			if (result.isFailure())
+				throw std::runtime_error(
+					"instantiation of transliterator instance failed with "
+					+ std::string(result.errorName()));
+		}
+		converter->transliterate(s);
+	}
+};
+
+bool isASCII(boost::string_ref s)
+{
+	return std::all_of(s.begin(), s.end(), [](char c) { return !(c & 0x80); });
+}
+
+// Strings with diacritics stripped. It's split into independently locked
+// parts, so that threads searching at the same time rarely wait for each
+// other. Each part keeps the most recently used strings.
+struct DiacriticsCache
+{
+	static const size_t Shards = 64;
+	static const size_t ShardCapacity = 4096;
+
+	struct Entry
+	{
+		std::string original;
+		std::string stripped;
+	};
+
+	struct Hash
+	{
+		size_t operator()(boost::string_ref s) const
+		{
+			// FNV-1a
+			uint64_t hash = 14695981039346656037ull;
+			for (char c : s)
+			{
+				hash ^= static_cast<unsigned char>(c);
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+
+	struct Shard
+	{
+		Shard() : entries(ShardCapacity) { }
+
+		std::mutex mutex;
+		// Keys point to original strings of entries. Entries are shared so
+		// that they can be used after the mutex is unlocked.
+		LRUCache<boost::string_ref, std::shared_ptr<const Entry>, Hash> entries;
+	};
+
+	Shard &shard(boost::string_ref s)
+	{
+		return m_shards[(Hash()(s) >> 32) % Shards];
+	}
+
+private:
+	Shard m_shards[Shards];
+};
+
+DiacriticsCache &diacriticsCache()
+{
+	// Never destroyed as worker threads may still use it at exit.
+	static DiacriticsCache *cache = new DiacriticsCache;
+	return *cache;
+}
+
+#endif // BOOST_REGEX_ICU
+
+char toLower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+char toUpper(char c)
+{
+	return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+}
+
+// Splits literals into parts consisting of ASCII characters and lower cases
+// them.
+std::vector<std::string> asciiLiterals(const std::vector<std::string> &literals)
+{
+	std::vector<std::string> result;
+	for (const auto &literal : literals)
+	{
+		std::string part;
+		for (char c : literal)
+		{
+			if (c & 0x80)
+			{
+				if (!part.empty())
+					result.push_back(std::move(part));
+				part.clear();
+			}
+			else
+				part += toLower(c);
+		}
+		if (!part.empty())
+			result.push_back(std::move(part));
+	}
+	return result;
+}
+
+// Checks whether s contains lower cased ASCII needle, ignoring case. Possible
+// occurrences are found with memchr as it's vectorized in most C libraries.
+bool containsIgnoringCase(boost::string_ref s, const std::string &needle)
+{
+	assert(!needle.empty());
+	if (needle.size() > s.size())
+		return false;
+	const char *first = s.data();
+	const char *last = s.data() + s.size() - needle.size() + 1;
+	char lower = needle[0], upper = toUpper(lower);
+	// Next occurrences of the first character in both cases.
+	const char *next_lower = first, *next_upper = lower == upper ? last : first;
+	auto find = [&last](const char *&next, const char *from, char c) {
+		if (next < from)
+			next = from;
+		if (next < last && *next != c)
+		{
+			next = static_cast<const char *>(memchr(next, c, last - next));
+			if (next == nullptr)
+				next = last;
+		}
+	};
+	while (first < last)
+	{
+		find(next_lower, first, lower);
+		if (lower != upper)
+			find(next_upper, first, upper);
+		const char *p = std::min(next_lower, next_upper);
+		if (p == last)
+			return false;
+		size_t i = 1;
+		while (i < needle.size() && toLower(p[i]) == needle[i])
+			++i;
+		if (i == needle.size())
+			return true;
+		first = p + 1;
+	}
+	return false;
+}
+
+}
+
+namespace Regex {
+
+bool Regex::mayMatch(boost::string_ref s) const
+{
+	return std::all_of(m_literals.begin(), m_literals.end(),
+	                   [s](const std::string &literal) {
+		                   return containsIgnoringCase(s, literal);
+	                   });
+}
+
+Regex make(const std::string &s,
+           boost::regex_constants::syntax_option_type flags)
+{
+	return Regex(
+#ifdef BOOST_REGEX_ICU
+		boost::make_u32regex(s, flags),
+#else
+		BasicRegex(s, flags),
+#endif // BOOST_REGEX_ICU
+		asciiLiterals(requiredLiterals(s, flags)));
+}
+
+NC::FilterRelation constraintRelation(
+	const std::string &constraint,
+	boost::regex_constants::syntax_option_type flags,
+	const std::string &previous_constraint,
+	boost::regex_constants::syntax_option_type previous_flags)
+{
+	if (flags != previous_flags)
+		return NC::FilterRelation::Unrelated;
+	if (constraint == previous_constraint)
+		return NC::FilterRelation::Same;
+	// Strings that match a longer literal also match its substrings (also when
+	// case or diacritics are ignored), which doesn't hold for regexes in general.
+	auto is_literal = [flags](const std::string &s) {
+		return (flags & boost::regex::literal)
+			|| s.find_first_of("\\^$.|?*+()[]{}") == std::string::npos;
+	};
+	if (is_literal(constraint)
+	    && is_literal(previous_constraint)
+	    && constraint.find(previous_constraint) != std::string::npos)
+		return NC::FilterRelation::Narrower;
+	return NC::FilterRelation::Unrelated;
+}
+
+#ifdef BOOST_REGEX_ICU
+
+std::string stripDiacritics(boost::string_ref s)
+{
+	// There is nothing to strip from ASCII strings.
+	if (isASCII(s))
+		return s.to_string();
+	auto us = icu::UnicodeString::fromUTF8(icu::StringPiece(s.data(), s.size()));
+	StripDiacritics::convert(us);
+	std::string result;
+	us.toUTF8String(result);
+	return result;
+}
+
+bool withoutDiacritics(boost::string_ref s,
+                       const std::function<bool(boost::string_ref)> &f)
+{
+	if (isASCII(s))
+		return f(s);
+
+	auto &shard = diacriticsCache().shard(s);
+	std::shared_ptr<const DiacriticsCache::Entry> entry;
+	{
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if (auto cached = shard.entries.get(s))
+			entry = *cached;
+	}
+	if (entry == nullptr)
+	{
+		// The string is converted with the mutex unlocked, so another thread
+		// may cache it in the meantime. The entry it stored is kept then as
+		// the key points to it.
+		auto new_entry = std::make_shared<DiacriticsCache::Entry>();
+		new_entry->original = s.to_string();
+		new_entry->stripped = stripDiacritics(s);
+		entry = std::move(new_entry);
+		std::lock_guard<std::mutex> lock(shard.mutex);
+		if (!shard.entries.contains(entry->original))
+			shard.entries.put(entry->original, entry);
+	}
+	return f(entry->stripped);
+}
+
+#endif // BOOST_REGEX_ICU
+
+std::vector<std::string> requiredLiterals(
+	const std::string &pattern,
+	boost::regex_constants::syntax_option_type flags)
+{
+	std::vector<std::string> result;
+	if (flags & boost::regex::literal)
+	{
+		if (!pattern.empty())
+			result.push_back(pattern);
+		return result;
+	}
+
+	std::string run;
+	auto end_run = [&] {
+		if (!run.empty())
+			result.push_back(std::move(run));
+		run.clear();
+	};
+	// Used when the last character became optional because of a quantifier.
+	auto drop_last = [&] {
+		while (!run.empty() && (run.back() & 0xC0) == 0x80)
+			run.pop_back();
+		if (!run.empty())
+			run.pop_back();
+		end_run();
+	};
+
+	bool basic = flags & boost::regex::basic_syntax_group;
+	bool escape_in_lists = !(flags & boost::regex::no_escape_in_lists);
+	for (size_t i = 0; i < pattern.size(); ++i)
+	{
+		switch (pattern[i])
+		{
+			case '|':
+				// Alternatives make all the literals optional.
+				return {};
+			case '*':
+			case '?':
+				drop_last();
+				break;
+			case '{':
+				drop_last();
+				i = pattern.find('}', i);
+				if (i == std::string::npos)
+					return result;
+				break;
+			case '+':
+			case '.':
+			case '^':
+			case '$':
+			case ')':
+				end_run();
+				break;
+			case '(':
+			{
+				// Inline modifiers, e.g. (?x) or (?i:...), change how the rest of
+				// the pattern is read.
+				if (pattern.compare(i, 2, "(?") == 0)
+				{
+					size_t j = i + 2;
+					while (j < pattern.size()
+					       && (std::isalpha(static_cast<unsigned char>(pattern[j]))
+					           || pattern[j] == '-'))
+						++j;
+					if (j > i + 2 && j < pattern.size()
+					    && (pattern[j] == ')' || pattern[j] == ':'))
+						return {};
+				}
+				// Groups may be quantified, skip them altogether.
+				end_run();
+				size_t depth = 1;
+				for (++i; i < pattern.size() && depth > 0; ++i)
+				{
+					if (pattern[i] == '\\')
+						++i;
+					else if (pattern[i] == '(')
+						++depth;
+					else if (pattern[i] == ')')
+						--depth;
+				}
+				--i;
+				break;
+			}
+			case '[':
+			{
+				end_run();
+				++i;
+				if (i < pattern.size() && pattern[i] == '^')
+					++i;
+				if (i < pattern.size() && pattern[i] == ']')
+					++i;
+				for (; i < pattern.size() && pattern[i] != ']'; ++i)
+				{
+					// skip [:class:], [=equiv=] and [.coll.] as a whole
+					if (pattern[i] == '['
+					    && i+1 < pattern.size()
+					    && strchr(":=.", pattern[i+1]))
+					{
+						char delimiter[] = { pattern[i+1], ']', 0 };
+						i = pattern.find(delimiter, i+2);
+						if (i == std::string::npos)
+							return result;
+						++i;
+					}
+					else if (pattern[i] == '\\' && escape_in_lists)
+						++i;
+				}
+				break;
+			}
+			case '\\':
+			{
+				if (++i == pattern.size())
+					break;
+				char c = pattern[i];
+				if (isalnum(static_cast<unsigned char>(c)))
+				{
+					// Character classes and assertions end the literal,
+					// anything else (back references, code points, \Q etc.)
+					// is not understood.
+					if (strchr("dwsDWSbBAzZ", c))
+						end_run();
+					else
+						return {};
+				}
+				else if (basic && strchr("(){}|+?", c))
+					return {};
+				else if (strchr("<>`'", c))
+					end_run(); // word and buffer boundaries
+				else
+					run += c;
+				break;
+			}
+			default:
+				run += pattern[i];
+		}
+	}
+	end_run();
+	return result;
+}
+
+}
@@ -31,42 +31,16 @@
 # include <boost/regex.hpp>
 #endif // BOOST_REGEX_ICU
 
+#include <boost/utility/string_ref.hpp>
 #include <cassert>
+#include <functional>
 #include <iostream>
+#include <string>
+#include <vector>
 
+#include "curses/menu.h"
 #include "utility/functional.h"
 
-namespace {
-
-#ifdef BOOST_REGEX_ICU
-
-struct StripDiacritics
-{
-	static void convert(icu::UnicodeString &s)
-	{
-		if (m_converter == nullptr)
-		{
-			icu::ErrorCode result;
-			m_converter = icu::Transliterator::createInstance(
-				"NFD; [:M:] Remove; NFC", UTRANS_FORWARD, result);
-			if (result.isFailure())
-				throw std::runtime_error(
-					"instantiation of transliterator instance failed with "
-					+ std::string(result.errorName()));
-		}
-		m_converter->transliterate(s);
-	}
-
-private:
-	static icu::Transliterator *m_converter;
-};
-
-icu::Transliterator *StripDiacritics::m_converter;
-
-#endif // BOOST_REGEX_ICU
-
-}
-
 namespace Regex {
 
 typedef
@@ -75,39 +49,74 @@ typedef
 #else
 	boost::regex
 #endif // BOOST_REGEX_ICU
-Regex;
+BasicRegex;
 
-template <typename StringT>
-inline Regex make(StringT &&s,
-                  boost::regex_constants::syntax_option_type flags)
+/// Compiled regular expression along with substrings that all strings it
+/// matches contain, so that most of the ones it doesn't match can be rejected
+/// without running the regex engine.
+struct Regex: BasicRegex
 {
-	return
+	Regex() { }
+	Regex(BasicRegex rx, std::vector<std::string> literals)
+	: BasicRegex(std::move(rx)), m_literals(std::move(literals)) { }
+
+	/// Required substrings (lower cased and consisting of ASCII characters
+	/// only as others may match case insensitively in a different form).
+	const std::vector<std::string> &literals() const { return m_literals; }
+
+	/// @return false if s certainly doesn't match the regex
+	bool mayMatch(boost::string_ref s) const;
+
+private:
+	std::vector<std::string> m_literals;
+};
+
+/// Extracts substrings that every string matched by the pattern has to
+/// contain. It errs on the side of returning less, so if nothing can be
+/// determined, the result is empty.
+std::vector<std::string> requiredLiterals(
+	const std::string &pattern,
+	boost::regex_constants::syntax_option_type flags);
+
+Regex make(const std::string &s,
+           boost::regex_constants::syntax_option_type flags);
+
+/// Determines whether strings matched by the first constraint are a subset of
+/// the ones matched by the second one. Only trivial cases (e.g. the first one
+/// being a literal extension of the second one) are recognized.
+NC::FilterRelation constraintRelation(
+	const std::string &constraint,
+	boost::regex_constants::syntax_option_type flags,
+	const std::string &previous_constraint,
+	boost::regex_constants::syntax_option_type previous_flags);
+
 #ifdef BOOST_REGEX_ICU
-	boost::make_u32regex
-#else
-	boost::regex
+/// @return UTF-8 string with diacritics stripped
+std::string stripDiacritics(boost::string_ref s);
+
+/// Strips diacritics from UTF-8 string and passes the result to f. Recently
+/// used results are cached, so that repeatedly searched strings are converted
+/// only once. Matching is done without any lock held.
+bool withoutDiacritics(boost::string_ref s,
+                       const std::function<bool(boost::string_ref)> &f);
 #endif // BOOST_REGEX_ICU
-	(std::forward<StringT>(s), flags);
-}
 
-template <typename CharT>
-inline bool search(const std::basic_string<CharT> &s,
+inline bool search(boost::string_ref s,
                    const Regex &rx,
                    bool ignore_diacritics)
 {
 	try {
 #ifdef BOOST_REGEX_ICU
 		if (ignore_diacritics)
-		{
-			auto us = icu::UnicodeString::fromUTF8(
-				icu::StringPiece(convertString<char, CharT>::apply(s)));
-			StripDiacritics::convert(us);
-			return boost::u32regex_search(us, rx);
-		}
+			return withoutDiacritics(s, [&rx](boost::string_ref folded) {
+				return rx.mayMatch(folded)
+					&& boost::u32regex_search(folded.begin(), folded.end(), rx);
+			});
 		else
-			return boost::u32regex_search(s, rx);
+			return rx.mayMatch(s)
+				&& boost::u32regex_search(s.begin(), s.end(), rx);
 #else
-		return boost::regex_search(s, rx);
+		return rx.mayMatch(s) && boost::regex_search(s.begin(), s.end(), rx);
 #endif // BOOST_REGEX_ICU
 	} catch (std::out_of_range &e) {
 		// Invalid UTF-8 sequence, ignore the string.
@@ -120,6 +129,15 @@ inline bool search(const std::basic_string<CharT> &s,
 	}
 }
 
+template <typename CharT>
+inline bool search(const std::basic_string<CharT> &s,
+                   const Regex &rx,
+                   bool ignore_diacritics)
+{
+	return search(boost::string_ref(convertString<char, CharT>::apply(s)),
+	              rx, ignore_diacritics);
+}
+
 template <typename T>
 struct Filter
 {
@@ -127,7 +145,7 @@ struct Filter
 	typedef typename NC::Menu<T>::Item Item;
 	typedef std::function<bool(const Regex &, const T &)> FilterFunction;
 
-	Filter() { }
+	Filter() : m_flags(boost::regex::normal) { }
 
 	template <typename FilterT>
 	Filter(const std::string &constraint_,
@@ -135,6 +153,7 @@ struct Filter
 	       FilterT &&filter)
 		: m_rx(make(constraint_, flags))
 		, m_constraint(constraint_)
+		, m_flags(flags)
 		, m_filter(std::forward<FilterT>(filter))
 	{ }
 
@@ -152,6 +171,15 @@ struct Filter
 		return m_filter(m_rx, item.value());
 	}
 
+	NC::FilterRelation relationTo(const Filter &previous) const {
+		return constraintRelation(m_constraint, m_flags,
+		                          previous.m_constraint, previous.m_flags);
+	}
+
+	bool isThreadSafe() const {
+		return true;
+	}
+
 	bool defined() const
 	{
 		return m_filter.operator bool();
@@ -160,6 +188,7 @@ struct Filter
 private:
 	Regex m_rx;
 	std::string m_constraint;
+	boost::regex_constants::syntax_option_type m_flags;
 	FilterFunction m_filter;
 };
 
@@ -169,7 +198,7 @@ template <typename T> struct ItemFilter
 	typedef typename NC::Menu<T>::Item Item;
 	typedef std::function<bool(const Regex &, const Item &)> FilterFunction;
 	
-	ItemFilter() { }
+	ItemFilter() : m_flags(boost::regex::normal) { }
 
 	template <typename FilterT>
 	ItemFilter(const std::string &constraint_,
@@ -177,6 +206,7 @@ template <typename T> struct ItemFilter
 	           FilterT &&filter)
 		: m_rx(make(constraint_, flags))
 		, m_constraint(constraint_)
+		, m_flags(flags)
 		, m_filter(std::forward<FilterT>(filter))
 	{ }
 	
@@ -189,9 +219,18 @@ template <typename T> struct ItemFilter
 		return m_constraint;
 	}
 
-	bool operator()(const Item &item) {
+	bool operator()(const Item &item) const {
 		return m_filter(m_rx, item);
 	}
+
+	NC::FilterRelation relationTo(const ItemFilter &previous) const {
+		return constraintRelation(m_constraint, m_flags,
+		                          previous.m_constraint, previous.m_flags);
+	}
+
+	bool isThreadSafe() const {
+		return true;
+	}
 	
 	bool defined() const
 	{
@@ -201,6 +240,7 @@ template <typename T> struct ItemFilter
 private:
 	Regex m_rx;
 	std::string m_constraint;
+	boost::regex_constants::syntax_option_type m_flags;
 	FilterFunction m_filter;
 };
 
@@ -389,9 +389,8 @@ std::vector<MPD::Song> Browser::getSelectedSongs()
 				break;
 		}
 	};
-	for (const auto &item : w)
-		if (item.isSelected())
-			item_handler(item.value());
+	for (auto pos : w.selectedPositions())
+		item_handler(w[pos].value());
 	// if no item is selected, add current one
 	if (songs.empty() && !w.empty())
 		item_handler(w.current()->value());
@@ -516,10 +515,11 @@ void Browser::getDirectory(std::string directory)
 
 		if (Config.browser_sort_mode != SortMode::None)
 		{
-			std::stable_sort(
-				w.begin() + (is_root ? 0 : 1), w.end(),
-				LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the,
-				                       Config.browser_sort_mode));
+			w.reorder(is_root ? 0 : 1, w.size(), [](auto first, auto last) {
+				sortByKeyOf(first, last,
+				            LocaleBasedItemSorting(std::locale(), Config.ignore_leading_the,
+				                                   Config.browser_sort_mode));
+			});
 		}
 	}
 
@@ -698,8 +698,8 @@ void getLocalDirectoryRecursively(std::vector<MPD::Song> &songs, const std::stri
 
 	if (Config.browser_sort_mode != SortMode::None)
 	{
-		std::stable_sort(songs.begin()+sort_offset, songs.end(),
-		                 LocaleBasedSorting(std::locale(), Config.ignore_leading_the)
+		sortByKeyOf(songs.begin()+sort_offset, songs.end(),
+		            LocaleBasedSorting(std::locale(), Config.ignore_leading_the)
 		);
 	}
 }
@@ -283,6 +283,7 @@ void write_bindings(NC::Scrollpad &w)
 	key(w, Type::EditSong, "Edit song");
 #	endif // HAVE_TAGLIB_H
 	key(w, Type::StartSearching, "Start searching");
+	key(w, Type::StopSearching, "Stop searching");
 	key(w, Type::ResetSearchEngine, "Reset search constraints and clear results");
 
 	key_section(w, "Media library");
@@ -28,6 +28,7 @@
 #include "display.h"
 #include "helpers.h"
 #include "global.h"
+#include "library_snapshot.h"
 #include "curses/menu_impl.h"
 #include "mpdpp.h"
 #include "screens/playlist.h"
@@ -71,23 +72,82 @@ std::string Date_(std::string date)
 	return date;
 }
 
-MPD::SongIterator getSongsFromAlbum(const AlbumEntry &album)
+// Returns the index of the library or nullptr if the server needs to be
+// queried instead.
+const LibraryIndex *libraryIndex()
 {
-	Mpd.StartSearch(true);
-	if (!isAlbumOnly)
-		Mpd.AddSearch(Config.media_lib_primary_tag, album.entry().tag());
-	if (!album.isAllTracksEntry())
+	if (!Config.media_library_index)
+		return nullptr;
+	try
 	{
+		return &Library.index();
+	}
+	catch (MPD::ServerError &e)
+	{
+		// Some servers can't list the whole database (e.g. mopidy with remote
+		// backends), fall back to querying them.
+		Config.media_library_index = false;
+		Statusbar::printf("Couldn't build index of the library: %1%", e.what());
+		return nullptr;
+	}
+}
+
+std::vector<MPD::Song> getSongsWithTag(const std::string &tag)
+{
+	std::vector<MPD::Song> result;
+	if (auto index = libraryIndex())
+	{
+		if (auto entry = index->findTag(tag))
+			for (const auto &album : entry->albums)
+				result.insert(result.end(), album.second.songs.begin(), album.second.songs.end());
+	}
+	else
+	{
+		Mpd.StartSearch(true);
+		Mpd.AddSearch(Config.media_lib_primary_tag, tag);
+		std::copy(
+			std::make_move_iterator(Mpd.CommitSearchSongs()),
+			std::make_move_iterator(MPD::SongIterator()),
+			std::back_inserter(result));
+	}
+	return result;
+}
+
+std::vector<MPD::Song> getSongsFromAlbum(const AlbumEntry &album)
+{
+	if (album.isAllTracksEntry())
+		return getSongsWithTag(album.entry().tag());
+	std::vector<MPD::Song> result;
+	if (auto index = libraryIndex())
+	{
+		auto entry = isAlbumOnly
+			? index->findAlbum(album.entry().album(), album.entry().date())
+			: index->findAlbum(album.entry().tag(), album.entry().album(), album.entry().date());
+		if (entry)
+			result = entry->songs;
+	}
+	else
+	{
+		Mpd.StartSearch(true);
+		if (!isAlbumOnly)
+			Mpd.AddSearch(Config.media_lib_primary_tag, album.entry().tag());
 		Mpd.AddSearch(MPD_TAG_ALBUM, album.entry().album());
 		if (Config.media_library_albums_split_by_date)
 			Mpd.AddSearch(MPD_TAG_DATE, album.entry().date());
+		std::copy(
+			std::make_move_iterator(Mpd.CommitSearchSongs()),
+			std::make_move_iterator(MPD::SongIterator()),
+			std::back_inserter(result));
 	}
-	return Mpd.CommitSearchSongs();
+	return result;
 }
 
 std::string AlbumToString(const AlbumEntry &ae);
 std::string SongToString(const MPD::Song &s);
 
+template <typename T>
+void showSongsInfo(NC::Menu<T> &menu, unsigned songs, unsigned long playtime);
+
 bool TagEntryMatcher(const Regex::Regex &rx, const MediaLibrary::PrimaryTag &tagmtime);
 bool AlbumEntryMatcher(const Regex::Regex &rx, const NC::Menu<AlbumEntry>::Item &item, bool filter);
 bool SongEntryMatcher(const Regex::Regex &rx, const MPD::Song &s);
@@ -95,6 +155,9 @@ bool SongEntryMatcher(const Regex::Regex &rx, const MPD::Song &s);
 bool MoveToTag(NC::Menu<PrimaryTag> &tags, const std::string &primary_tag);
 bool MoveToAlbum(NC::Menu<AlbumEntry> &albums, const std::string &primary_tag, const MPD::Song &s, bool consider_date);
 
+// Sorting is done with sortByKey, so these compute keys for each element
+// instead of comparing elements directly.
+
 struct SortSongs {
 	typedef NC::Menu<MPD::Song>::Item SongItem;
 	
@@ -105,31 +168,31 @@ struct SortSongs {
 public:
 	SortSongs()
 	: m_cmp(std::locale(), Config.ignore_leading_the) { }
-	
-	bool operator()(const SongItem &a, const SongItem &b) {
-		return (*this)(a.value(), b.value());
-	}
-	bool operator()(const MPD::Song &a, const MPD::Song &b) {
-		int ret;
-		for (auto get : GetFuns) {
-			ret = m_cmp(a.getTags(get), b.getTags(get));
-			if (ret != 0)
-				return ret < 0;
-		}
 
-		// Sort by track numbers.
+	// Tags from GetFuns, then track number (ones that are not numbers go
+	// first) and if track numbers are equal, the display format.
+	typedef std::tuple<
+		std::string, std::string, std::string, bool, int, std::string, std::string
+	> Key;
+
+	Key key(const SongItem &a) const {
+		return key(a.value());
+	}
+	Key key(const MPD::Song &a) const {
+		int track_number = 0;
+		bool numeric = true;
 		try {
-			ret = boost::lexical_cast<int>(a.getTags(&MPD::Song::getTrackNumber))
-			    - boost::lexical_cast<int>(b.getTags(&MPD::Song::getTrackNumber));
+			track_number = boost::lexical_cast<int>(a.getTags(&MPD::Song::getTrackNumber));
 		} catch (boost::bad_lexical_cast &) {
-			ret = a.getTrackNumber().compare(b.getTrackNumber());
+			numeric = false;
 		}
-		if (ret != 0)
-			return ret < 0;
-
-		// If track numbers are equal, sort by the display format.
-		return Format::stringify<char>(Config.song_library_format, &a)
-		     < Format::stringify<char>(Config.song_library_format, &b);
+		return Key(m_cmp.key(a.getTags(GetFuns[0])),
+		           m_cmp.key(a.getTags(GetFuns[1])),
+		           m_cmp.key(a.getTags(GetFuns[2])),
+		           numeric,
+		           track_number,
+		           numeric ? std::string() : a.getTrackNumber(),
+		           Format::stringify<char>(Config.song_library_format, &a));
 	}
 };
 
@@ -146,25 +209,20 @@ class SortAlbumEntries {
 
 public:
 	SortAlbumEntries() : m_cmp(std::locale(), Config.ignore_leading_the) { }
-	
-	bool operator()(const AlbumEntry &a, const AlbumEntry &b) const {
-		return (*this)(a.entry(), b.entry());
-	}
 
-	bool operator()(const Album &a, const Album &b) const {
+	// Modification time (negated, so that the newest albums come first) or
+	// tag, date and album.
+	typedef std::tuple<time_t, std::string, std::string, std::string> Key;
+
+	Key key(const AlbumEntry &a) const {
+		const Album &album = a.entry();
 		if (Config.media_library_sort_by_mtime)
-			return a.mtime() > b.mtime();
+			return Key(-album.mtime(), "", "", "");
 		else
-		{
-			int result;
-			result = m_cmp(a.tag(), b.tag());
-			if (result != 0)
-				return result < 0;
-			result = m_cmp(a.date(), b.date());
-			if (result != 0)
-				return result < 0;
-			return m_cmp(a.album(), b.album()) < 0;
-		}
+			return Key(0,
+			           m_cmp.key(album.tag()),
+			           m_cmp.key(album.date()),
+			           m_cmp.key(album.album()));
 	}
 };
 
@@ -173,12 +231,14 @@ class SortPrimaryTags {
 	
 public:
 	SortPrimaryTags() : m_cmp(std::locale(), Config.ignore_leading_the) { }
-	
-	bool operator()(const PrimaryTag &a, const PrimaryTag &b) const {
+
+	typedef std::pair<time_t, std::string> Key;
+
+	Key key(const PrimaryTag &a) const {
 		if (Config.media_library_sort_by_mtime)
-			return a.mtime() > b.mtime();
+			return Key(-a.mtime(), "");
 		else
-			return m_cmp(a.tag(), b.tag()) < 0;
+			return Key(0, m_cmp.key(a.tag()));
 	}
 };
 
@@ -214,6 +274,7 @@ MediaLibrary::MediaLibrary()
 			menu << Config.empty_tag;
 		else
 			menu << Charset::utf8ToLocale(tag);
+		showSongsInfo(menu, menu.drawn()->value().songs(), menu.drawn()->value().playtime());
 	});
 	
 	Albums = NC::Menu<AlbumEntry>(itsMiddleColStartX, MainStartY, itsMiddleColWidth, MainHeight, Config.titles_visibility ? "Albums" : "", Config.main_color, NC::Border());
@@ -223,7 +284,10 @@ MediaLibrary::MediaLibrary()
 	Albums.setSelectedPrefix(Config.selected_item_prefix);
 	Albums.setSelectedSuffix(Config.selected_item_suffix);
 	Albums.setItemDisplayer([](NC::Menu<AlbumEntry> &menu) {
-		menu << Charset::utf8ToLocale(AlbumToString(menu.drawn()->value()));
+		const auto &ae = menu.drawn()->value();
+		menu << Charset::utf8ToLocale(AlbumToString(ae));
+		if (!ae.isAllTracksEntry())
+			showSongsInfo(menu, ae.entry().songs(), ae.entry().playtime());
 	});
 	
 	Songs = NC::Menu<MPD::Song>(itsRightColStartX, MainStartY, itsRightColWidth, MainHeight, Config.titles_visibility ? "Songs" : "", Config.main_color, NC::Border());
@@ -306,6 +370,7 @@ std::wstring MediaLibrary::title()
 
 void MediaLibrary::update()
 {
+	const LibraryIndex *index = libraryIndex();
 	if (hasTwoColumns)
 	{
 		ScopedUnfilteredMenu<AlbumEntry> sunfilter_albums(ReapplyFilter::No, Albums);
@@ -313,52 +378,95 @@ void MediaLibrary::update()
 		{
 			m_albums_update_request = false;
 			sunfilter_albums.set(ReapplyFilter::Yes, true);
-			std::map<std::tuple<std::string, std::string, std::string>, time_t> albums;
-			MPD::SongIterator s, end;
-			try
+			size_t idx = 0;
+			auto add_album = [this, &idx](Album album) {
+				auto entry = AlbumEntry(std::move(album));
+				if (idx < Albums.size())
+					Albums[idx].value() = std::move(entry);
+				else
+					Albums.addItem(std::move(entry));
+				++idx;
+			};
+			if (index && isAlbumOnly)
 			{
-				s = Mpd.GetDirectoryRecursive("/");
+				for (const auto &album : index->albums())
+					add_album(Album("", album.first.first, album.first.second,
+					                album.second.mtime,
+					                album.second.songs.size(),
+					                album.second.playtime));
 			}
-			catch (MPD::Error &e)
+			else if (index)
 			{
-				// If there was a problem, fall back to a different column mode.
-				toggleColumnsMode();
-				throw;
+				for (const auto &tag : index->tags())
+					for (const auto &album : tag.second.albums)
+						add_album(Album(tag.first, album.first.first, album.first.second,
+						                album.second.mtime,
+						                album.second.songs.size(),
+						                album.second.playtime));
 			}
-			for (; s != end; ++s)
+			else if (!Config.media_library_sort_by_mtime && Mpd.SupportsTagGroups())
 			{
-				std::string tag;
-				unsigned idx = 0;
-				while (!(tag = s->get(Config.media_lib_primary_tag, idx++)).empty())
+				// Let the server group albums, we don't need modification times.
+				std::vector<mpd_tag_type> groups;
+				if (!isAlbumOnly)
+					groups.push_back(Config.media_lib_primary_tag);
+				if (Config.media_library_albums_split_by_date)
+					groups.push_back(MPD_TAG_DATE);
+				MPD::TagGroupIterator album = Mpd.GetGroupedList(MPD_TAG_ALBUM, groups), end;
+				for (; album != end; ++album)
 				{
-					auto key = std::make_tuple(
-						isAlbumOnly ? "" : std::move(tag),
-						s->getAlbum(),
-						Date_(s->getDate()));
-					auto it = albums.find(key);
-					if (it == albums.end())
-						albums[std::move(key)] = s->getMTime();
-					else
-						it->second = s->getMTime();
+					std::string tag, date;
+					if (!isAlbumOnly)
+					{
+						tag = std::move((*album)[1]);
+						if (tag.empty())
+							continue;
+					}
+					if (Config.media_library_albums_split_by_date)
+						date = std::move(album->back());
+					add_album(Album(std::move(tag), std::move((*album)[0]), std::move(date), 0));
 				}
 			}
-			size_t idx = 0;
-			for (const auto &album : albums)
+			else
 			{
-				auto entry = AlbumEntry(
-					Album(std::move(std::get<0>(album.first)),
-					      std::move(std::get<1>(album.first)),
-					      std::move(std::get<2>(album.first)),
-					      album.second));
-				if (idx < Albums.size())
-					Albums[idx].value() = std::move(entry);
-				else
-					Albums.addItem(std::move(entry));
-				++idx;
+				std::map<std::tuple<std::string, std::string, std::string>, time_t> albums;
+				const std::vector<MPD::Song> *songs;
+				try
+				{
+					songs = &Library.songs();
+				}
+				catch (MPD::Error &e)
+				{
+					// If there was a problem, fall back to a different column mode.
+					toggleColumnsMode();
+					throw;
+				}
+				for (const auto &s : *songs)
+				{
+					std::string tag;
+					unsigned tag_idx = 0;
+					while (!(tag = s.get(Config.media_lib_primary_tag, tag_idx++)).empty())
+					{
+						auto key = std::make_tuple(
+							isAlbumOnly ? "" : std::move(tag),
+							s.getAlbum(),
+							Date_(s.getDate()));
+						auto it = albums.find(key);
+						if (it == albums.end())
+							albums[std::move(key)] = s.getMTime();
+						else
+							it->second = s.getMTime();
+					}
+				}
+				for (const auto &album : albums)
+					add_album(Album(std::move(std::get<0>(album.first)),
+					                std::move(std::get<1>(album.first)),
+					                std::move(std::get<2>(album.first)),
+					                album.second));
 			}
 			if (idx < Albums.size())
 				Albums.resizeList(idx);
-			std::sort(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+			sortByKeyOf(Albums.beginV(), Albums.endV(), SortAlbumEntries());
 		}
 	}
 	else
@@ -369,13 +477,27 @@ void MediaLibrary::update()
 			{
 				m_tags_update_request = false;
 				sunfilter_tags.set(ReapplyFilter::Yes, true);
-				std::map<std::string, time_t> tags;
-				if (Config.media_library_sort_by_mtime)
+				size_t idx = 0;
+				auto add_tag = [this, &idx](PrimaryTag ptag) {
+					if (idx < Tags.size())
+						Tags[idx].value() = std::move(ptag);
+					else
+						Tags.addItem(std::move(ptag));
+					++idx;
+				};
+				if (index)
 				{
-					MPD::SongIterator s, end;
+					for (const auto &tag : index->tags())
+						add_tag(PrimaryTag(tag.first, tag.second.mtime,
+						                   tag.second.songs, tag.second.playtime));
+				}
+				else if (Config.media_library_sort_by_mtime)
+				{
+					std::map<std::string, time_t> tags;
+					const std::vector<MPD::Song> *songs;
 					try
 					{
-						s = Mpd.GetDirectoryRecursive("/");
+						songs = &Library.songs();
 					}
 					catch (MPD::Error &e)
 					{
@@ -383,71 +505,53 @@ void MediaLibrary::update()
 						toggleSortMode();
 						throw;
 					}
-					for (; s != end; ++s)
+					for (const auto &s : *songs)
 					{
 						std::string tag;
-						unsigned idx = 0;
-						while (!(tag = s->get(Config.media_lib_primary_tag, idx++)).empty())
+						unsigned tag_idx = 0;
+						while (!(tag = s.get(Config.media_lib_primary_tag, tag_idx++)).empty())
 						{
 							auto it = tags.find(tag);
 							if (it == tags.end())
-								tags[std::move(tag)] = s->getMTime();
+								tags[std::move(tag)] = s.getMTime();
 							else
-								it->second = std::max(it->second, s->getMTime());
+								it->second = std::max(it->second, s.getMTime());
 						}
 					}
+					for (const auto &tag : tags)
+						add_tag(PrimaryTag(std::move(tag.first), tag.second));
 				}
-				else
+				else if (Mpd.SupportsTagGroups())
 				{
-					MPD::StringIterator tag = Mpd.GetList(Config.media_lib_primary_tag), end;
+					MPD::TagCountIterator tag = Mpd.GetTagCounts(Config.media_lib_primary_tag), end;
 					for (; tag != end; ++tag)
-						tags[std::move(*tag)] = 0;
+						if (!tag->tag().empty())
+							add_tag(PrimaryTag(tag->tag(), 0, tag->songs(), tag->playtime()));
 				}
-				size_t idx = 0;
-				for (const auto &tag : tags)
+				else
 				{
-					auto ptag = PrimaryTag(std::move(tag.first), tag.second);
-					if (idx < Tags.size())
-						Tags[idx].value() = std::move(ptag);
-					else
-						Tags.addItem(std::move(ptag));
-					++idx;
+					MPD::StringIterator tag = Mpd.GetList(Config.media_lib_primary_tag), end;
+					for (; tag != end; ++tag)
+						add_tag(PrimaryTag(std::move(*tag), 0));
 				}
 				if (idx < Tags.size())
 					Tags.resizeList(idx);
-				std::sort(Tags.beginV(), Tags.endV(), SortPrimaryTags());
+				sortByKeyOf(Tags.beginV(), Tags.endV(), SortPrimaryTags());
 			}
 		}
 
 		{
 			ScopedUnfilteredMenu<AlbumEntry> sunfilter_albums(ReapplyFilter::No, Albums);
 			if (!Tags.empty()
-			    && ((Albums.empty() && Global::Timer - m_timer > m_fetching_delay)
+			    && ((Albums.empty() && (index || Global::Timer - m_timer > m_fetching_delay))
 			        || m_albums_update_request))
 			{
 				m_albums_update_request = false;
 				sunfilter_albums.set(ReapplyFilter::Yes, true);
 				auto &primary_tag = Tags.current()->value().tag();
-				Mpd.StartSearch(true);
-				Mpd.AddSearch(Config.media_lib_primary_tag, primary_tag);
-				std::map<std::tuple<std::string, std::string>, time_t> albums;
-				for (MPD::SongIterator s = Mpd.CommitSearchSongs(), end; s != end; ++s)
-				{
-					auto key = std::make_tuple(s->getAlbum(), Date_(s->getDate()));
-					auto it = albums.find(key);
-					if (it == albums.end())
-						albums[std::move(key)] = s->getMTime();
-					else
-						it->second = std::max(it->second, s->getMTime());
-				};
 				size_t idx = 0;
-				for (const auto &album : albums)
-				{
-					auto entry = AlbumEntry(
-						Album(primary_tag,
-						      std::move(std::get<0>(album.first)),
-						      std::move(std::get<1>(album.first)),
-						      album.second));
+				auto add_album = [this, &idx](Album album) {
+					auto entry = AlbumEntry(std::move(album));
 					if (idx < Albums.size())
 					{
 						Albums[idx].value() = std::move(entry);
@@ -456,11 +560,63 @@ void MediaLibrary::update()
 					else
 						Albums.addItem(std::move(entry));
 					++idx;
+				};
+				if (index)
+				{
+					if (auto tag = index->findTag(primary_tag))
+						for (const auto &album : tag->albums)
+							add_album(Album(primary_tag, album.first.first, album.first.second,
+							                album.second.mtime,
+							                album.second.songs.size(),
+							                album.second.playtime));
+				}
+				else if (!Config.media_library_sort_by_mtime && Mpd.SupportsTagGroups())
+				{
+					if (Config.media_library_albums_split_by_date)
+					{
+						MPD::TagGroupIterator album = Mpd.GetGroupedList(
+							MPD_TAG_ALBUM, { MPD_TAG_DATE }, Config.media_lib_primary_tag, primary_tag);
+						for (MPD::TagGroupIterator end; album != end; ++album)
+							add_album(Album(primary_tag,
+							                std::move((*album)[0]),
+							                std::move((*album)[1]),
+							                0));
+					}
+					else
+					{
+						// Count can be grouped by one tag only, so sizes of
+						// albums are known only if they're not split by date.
+						MPD::TagCountIterator album = Mpd.GetTagCounts(
+							MPD_TAG_ALBUM, Config.media_lib_primary_tag, primary_tag);
+						for (MPD::TagCountIterator end; album != end; ++album)
+							add_album(Album(primary_tag, album->tag(), "", 0,
+							                album->songs(), album->playtime()));
+					}
+				}
+				else
+				{
+					Mpd.StartSearch(true);
+					Mpd.AddSearch(Config.media_lib_primary_tag, primary_tag);
+					std::map<std::tuple<std::string, std::string>, time_t> albums;
+					for (MPD::SongIterator s = Mpd.CommitSearchSongs(), end; s != end; ++s)
+					{
+						auto key = std::make_tuple(s->getAlbum(), Date_(s->getDate()));
+						auto it = albums.find(key);
+						if (it == albums.end())
+							albums[std::move(key)] = s->getMTime();
+						else
+							it->second = std::max(it->second, s->getMTime());
+					};
+					for (const auto &album : albums)
+						add_album(Album(primary_tag,
+						                std::move(std::get<0>(album.first)),
+						                std::move(std::get<1>(album.first)),
+						                album.second));
 				}
 				if (idx < Albums.size())
 					Albums.resizeList(idx);
-				std::sort(Albums.beginV(), Albums.endV(), SortAlbumEntries());
-				if (albums.size() > 1)
+				sortByKeyOf(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+				if (idx > 1)
 				{
 					Albums.addSeparator();
 					Albums.addItem(AlbumEntry::mkAllTracksEntry(primary_tag));
@@ -471,24 +627,26 @@ void MediaLibrary::update()
 
 	ScopedUnfilteredMenu<MPD::Song> sunfilter_songs(ReapplyFilter::No, Songs);
 	if (!Albums.empty()
-	    && ((Songs.empty() && Global::Timer - m_timer > m_fetching_delay)
+	    && ((Songs.empty() && (index || Global::Timer - m_timer > m_fetching_delay))
 	        || m_songs_update_request))
 	{
 		m_songs_update_request = false;
 		sunfilter_songs.set(ReapplyFilter::Yes, true);
-		auto &album = Albums.current()->value();
+		auto songs = getSongsFromAlbum(Albums.current()->value());
 		size_t idx = 0;
-		for (MPD::SongIterator s = getSongsFromAlbum(album), end;
-		     s != end; ++s, ++idx)
+		for (auto &s : songs)
 		{
 			if (idx < Songs.size())
-				Songs[idx].value() = std::move(*s);
+				Songs[idx].value() = std::move(s);
 			else
-				Songs.addItem(std::move(*s));
-		};
+				Songs.addItem(std::move(s));
+			++idx;
+		}
 		if (idx < Songs.size())
 			Songs.resizeList(idx);
-		std::sort(Songs.begin(), Songs.end(), SortSongs());
+		Songs.reorder(0, Songs.size(), [](auto first, auto last) {
+			sortByKeyOf(first, last, SortSongs());
+		});
 	}
 }
 
@@ -735,12 +893,8 @@ bool MediaLibrary::addItemToPlaylist(bool play)
 		if (isActiveWindow(Tags)
 		||  (isActiveWindow(Albums) && Albums.current()->value().isAllTracksEntry()))
 		{
-			Mpd.StartSearch(true);
-			Mpd.AddSearch(Config.media_lib_primary_tag, Tags.current()->value().tag());
-			std::vector<MPD::Song> list(
-				std::make_move_iterator(Mpd.CommitSearchSongs()),
-				std::make_move_iterator(MPD::SongIterator()));
-			std::sort(list.begin(), list.end(), SortSongs());
+			auto list = getSongsWithTag(Tags.current()->value().tag());
+			sortByKeyOf(list.begin(), list.end(), SortSongs());
 			result = addSongsToPlaylist(list.begin(), list.end(), play, -1);
 			std::string tag_type = boost::locale::to_lower(
 				tagTypeToString(Config.media_lib_primary_tag));
@@ -749,10 +903,8 @@ bool MediaLibrary::addItemToPlaylist(bool play)
 		}
 		else if (isActiveWindow(Albums))
 		{
-			std::vector<MPD::Song> list(
-				std::make_move_iterator(getSongsFromAlbum(Albums.current()->value())),
-				std::make_move_iterator(MPD::SongIterator()));
-			std::sort(list.begin(), list.end(), SortSongs());
+			auto list = getSongsFromAlbum(Albums.current()->value());
+			sortByKeyOf(list.begin(), list.end(), SortSongs());
 			result = addSongsToPlaylist(list.begin(), list.end(), play, -1);
 			Statusbar::printf("Songs from album \"%1%\" added%2%",
 				Albums.current()->value().entry().album(), withErrors(result));
@@ -767,23 +919,16 @@ std::vector<MPD::Song> MediaLibrary::getSelectedSongs()
 	if (isActiveWindow(Tags))
 	{
 		auto tag_handler = [&result](const std::string &tag) {
-			Mpd.StartSearch(true);
-			Mpd.AddSearch(Config.media_lib_primary_tag, tag);
+			auto songs = getSongsWithTag(tag);
 			size_t begin = result.size();
-			std::copy(
-				std::make_move_iterator(Mpd.CommitSearchSongs()),
-				std::make_move_iterator(MPD::SongIterator()),
-				std::back_inserter(result));
-			std::sort(result.begin()+begin, result.end(), SortSongs());
+			std::move(songs.begin(), songs.end(), std::back_inserter(result));
+			sortByKeyOf(result.begin()+begin, result.end(), SortSongs());
 		};
 		bool any_selected = false;
-		for (auto &e : Tags)
+		for (auto pos : Tags.selectedPositions())
 		{
-			if (e.isSelected())
-			{
-				any_selected = true;
-				tag_handler(e.value().tag());
-			}
+			any_selected = true;
+			tag_handler(Tags[pos].value().tag());
 		}
 		// if no item is selected, add current one
 		if (!any_selected && !Tags.empty())
@@ -797,35 +942,20 @@ std::vector<MPD::Song> MediaLibrary::getSelectedSongs()
 			if (it->isSelected())
 			{
 				any_selected = true;
-				auto &sc = it->value();
-				Mpd.StartSearch(true);
-				if (hasTwoColumns)
-					Mpd.AddSearch(Config.media_lib_primary_tag, sc.entry().tag());
-				else
-					Mpd.AddSearch(Config.media_lib_primary_tag,
-					              Tags.current()->value().tag());
-				Mpd.AddSearch(MPD_TAG_ALBUM, sc.entry().album());
-				if (Config.media_library_albums_split_by_date)
-					Mpd.AddSearch(MPD_TAG_DATE, sc.entry().date());
+				auto songs = getSongsFromAlbum(it->value());
 				size_t begin = result.size();
-				std::copy(
-					std::make_move_iterator(Mpd.CommitSearchSongs()),
-					std::make_move_iterator(MPD::SongIterator()),
-					std::back_inserter(result));
-				std::sort(result.begin()+begin, result.end(), SortSongs());
+				std::move(songs.begin(), songs.end(), std::back_inserter(result));
+				sortByKeyOf(result.begin()+begin, result.end(), SortSongs());
 			}
 		}
 		// if no item is selected, add songs from right column
 		ScopedUnfilteredMenu<MPD::Song> sunfilter_songs(ReapplyFilter::No, Songs);
 		if (!any_selected && !Albums.empty())
 		{
+			auto songs = getSongsFromAlbum(Albums.current()->value());
 			size_t begin = result.size();
-			std::copy(
-				std::make_move_iterator(getSongsFromAlbum(Albums.current()->value())),
-				std::make_move_iterator(MPD::SongIterator()),
-				std::back_inserter(result)
-			);
-			std::sort(result.begin()+begin, result.end(), SortSongs());
+			std::move(songs.begin(), songs.end(), std::back_inserter(result));
+			sortByKeyOf(result.begin()+begin, result.end(), SortSongs());
 		}
 	}
 	else if (isActiveWindow(Songs))
@@ -971,7 +1101,7 @@ void MediaLibrary::toggleSortMode()
 	if (hasTwoColumns)
 	{
 		ScopedUnfilteredMenu<AlbumEntry> sunfilter_albums(ReapplyFilter::No, Albums);
-		std::sort(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+		sortByKeyOf(Albums.beginV(), Albums.endV(), SortAlbumEntries());
 		Albums.refresh();
 		Songs.clear();
 		if (Config.titles_visibility)
@@ -996,7 +1126,7 @@ void MediaLibrary::toggleSortMode()
 		// if we already have modification times, just resort. otherwise refetch the list.
 		if (!Tags.empty() && Tags[0].value().mtime() > 0)
 		{
-			std::sort(Tags.beginV(), Tags.endV(), SortPrimaryTags());
+			sortByKeyOf(Tags.beginV(), Tags.endV(), SortPrimaryTags());
 			Tags.refresh();
 		}
 		else
@@ -1048,7 +1178,7 @@ void MediaLibrary::locateSong(const MPD::Song &s)
 			// possible to list all of the library, e.g. mopidy with mopidy-spotify.
 			// To workaround this we simply insert the missing tag.
 			Tags.addItem(PrimaryTag(primary_tag, s.getMTime()));
-			std::sort(Tags.beginV(), Tags.endV(), SortPrimaryTags());
+			sortByKeyOf(Tags.beginV(), Tags.endV(), SortPrimaryTags());
 			Tags.refresh();
 			MoveToTag(Tags, primary_tag);
 		}
@@ -1092,7 +1222,7 @@ void MediaLibrary::locateSong(const MPD::Song &s)
 			                                s.getAlbum(),
 			                                Date_(s.getDate()),
 			                                s.getMTime())));
-			std::sort(Albums.beginV(), Albums.endV(), SortAlbumEntries());
+			sortByKeyOf(Albums.beginV(), Albums.endV(), SortAlbumEntries());
 			Albums.refresh();
 			MoveToAlbum(Albums, primary_tag, s, true);
 		}
@@ -1146,6 +1276,31 @@ std::string AlbumToString(const AlbumEntry &ae)
 	return result;
 }
 
+// Show number of songs of the entry along with their total length (if they're
+// known) at the right edge of the column.
+template <typename T>
+void showSongsInfo(NC::Menu<T> &menu, unsigned songs, unsigned long playtime)
+{
+	if (songs == 0)
+		return;
+	std::string info = "(" + boost::lexical_cast<std::string>(songs)
+		+ ", " + MPD::Song::ShowTime(playtime) + ")";
+	int x_off = menu.getWidth() - info.length();
+	if (menu.isHighlighted() && menu.drawn() == menu.current())
+	{
+		if (menu.highlightSuffix() == Config.current_item_suffix)
+			x_off -= Config.current_item_suffix_length;
+		else
+			x_off -= Config.current_item_inactive_column_suffix_length;
+	}
+	if (menu.drawn()->isSelected())
+		x_off -= Config.selected_item_suffix_length;
+	// Don't cover the entry itself.
+	if (x_off <= menu.getX())
+		return;
+	menu << NC::TermManip::ClearToEOL << NC::XY(x_off, menu.getY()) << info;
+}
+
 std::string SongToString(const MPD::Song &s)
 {
 	return Format::stringify<char>(
@@ -85,34 +85,50 @@ struct MediaLibrary: Screen<NC::Window *>, Filterable, HasColumns, HasSongs, Sea
 	
 	struct PrimaryTag
 	{
-		PrimaryTag() : m_mtime(0) { }
-		PrimaryTag(std::string tag_, time_t mtime_)
-		: m_tag(std::move(tag_)), m_mtime(mtime_) { }
+		PrimaryTag() : m_mtime(0), m_songs(0), m_playtime(0) { }
+		PrimaryTag(std::string tag_, time_t mtime_,
+		           unsigned songs_ = 0, unsigned long playtime_ = 0)
+		: m_tag(std::move(tag_)), m_mtime(mtime_)
+		, m_songs(songs_), m_playtime(playtime_) { }
 		
 		const std::string &tag() const { return m_tag; }
 		time_t mtime() const { return m_mtime; }
 		
+		// zero if not known
+		unsigned songs() const { return m_songs; }
+		unsigned long playtime() const { return m_playtime; }
+		
 	private:
 		std::string m_tag;
 		time_t m_mtime;
+		unsigned m_songs;
+		unsigned long m_playtime;
 	};
 	
 	struct Album
 	{
-		Album(std::string tag_, std::string album_, std::string date_, time_t mtime_)
+		Album(std::string tag_, std::string album_, std::string date_, time_t mtime_,
+		      unsigned songs_ = 0, unsigned long playtime_ = 0)
 		: m_tag(std::move(tag_)), m_album(std::move(album_))
-		, m_date(std::move(date_)), m_mtime(mtime_) { }
+		, m_date(std::move(date_)), m_mtime(mtime_)
+		, m_songs(songs_), m_playtime(playtime_) { }
 		
 		const std::string &tag() const { return m_tag; }
 		const std::string &album() const { return m_album; }
 		const std::string &date() const { return m_date; }
 		time_t mtime() const { return m_mtime; }
 		
+		// zero if not known
+		unsigned songs() const { return m_songs; }
+		unsigned long playtime() const { return m_playtime; }
+		
 	private:
 		std::string m_tag;
 		std::string m_album;
 		std::string m_date;
 		time_t m_mtime;
+		unsigned m_songs;
+		unsigned long m_playtime;
 	};
 	
 	struct AlbumEntry
@@ -306,12 +306,18 @@ std::string Playlist::getTotalLength()
 
 void Playlist::setSelectedItemsPriority(int prio)
 {
-	auto list = getSelectedOrCurrent(w.begin(), w.end(), w.current());
+	auto list = getSelectedOrCurrent(w);
+	std::vector<unsigned> positions;
+	positions.reserve(list.size());
+	for (const auto &it : list)
+		positions.push_back(it->value().getPosition());
+	auto ranges = positionsToRanges(std::move(positions));
 	Mpd.StartCommandsList();
-	for (auto it = list.begin(); it != list.end(); ++it)
-		Mpd.SetPriority((*it)->value(), prio);
+	for (const auto &range : ranges)
+		Mpd.SetPriorityRange(range.first, range.second, prio);
 	Mpd.CommitCommandsList();
-	Statusbar::print("Priority set");
+	Statusbar::printf("Priority set (%1% command%2%)",
+		ranges.size(), ranges.size() == 1 ? "" : "s");
 }
 
 bool Playlist::checkForSong(const MPD::Song &s)
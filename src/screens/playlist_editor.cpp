@@ -50,6 +50,10 @@ PlaylistEditor *myPlaylistEditor;
 
 namespace {
 
+// number of playlists on each side of the highlighted one to prefetch
+const size_t PrefetchedNeighbours = 2;
+const size_t ContentCacheSize = 16;
+
 size_t LeftColumnStartX;
 size_t LeftColumnWidth;
 size_t RightColumnStartX;
@@ -65,6 +69,9 @@ PlaylistEditor::PlaylistEditor()
 : m_timer(boost::posix_time::from_time_t(0))
 , m_window_timeout(Config.data_fetching_delay ? 250 : BaseScreen::defaultWindowTimeout)
 , m_fetching_delay(boost::posix_time::milliseconds(Config.data_fetching_delay ? 250 : -1))
+, m_content_cache(ContentCacheSize)
+, m_content_cache_generation(0)
+, m_prefetch_failed(false)
 {
 	size_t ra = Config.playlist_editor_column_width_ratio[0];
 	size_t rb = Config.playlist_editor_column_width_ratio[1];
@@ -176,27 +183,42 @@ void PlaylistEditor::update()
 			}
 			if (idx < Playlists.size())
 				Playlists.resizeList(idx);
-			std::sort(Playlists.beginV(), Playlists.endV(),
-			          LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
+			sortByKeyOf(Playlists.beginV(), Playlists.endV(),
+			            LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		}
 	}
 
 	{
 		ScopedUnfilteredMenu<MPD::Song> sunfilter_content(ReapplyFilter::No, Content);
+		const std::vector<MPD::Song> *cached = nullptr;
+		if (!Playlists.empty() && Content.empty() && !m_content_update_requested)
+			cached = m_content_cache.get(Playlists.current()->value().path());
 		if (!Playlists.empty()
-		    && ((Content.empty() && Global::Timer - m_timer > m_fetching_delay)
+		    && ((Content.empty() && (cached || Global::Timer - m_timer > m_fetching_delay))
 		        || m_content_update_requested))
 		{
 			m_content_update_requested = false;
 			sunfilter_content.set(ReapplyFilter::Yes, true);
+			const auto &path = Playlists.current()->value().path();
+			std::vector<MPD::Song> songs;
+			if (cached)
+				songs = *cached;
+			else
+			{
+				std::copy(
+					std::make_move_iterator(Mpd.GetPlaylistContent(path)),
+					std::make_move_iterator(MPD::SongIterator()),
+					std::back_inserter(songs));
+				m_content_cache.put(path, songs);
+			}
 			size_t idx = 0;
-			MPD::SongIterator s = Mpd.GetPlaylistContent(Playlists.current()->value().path()), end;
-			for (; s != end; ++s, ++idx)
+			for (auto &s : songs)
 			{
 				if (idx < Content.size())
-					Content[idx].value() = std::move(*s);
+					Content[idx].value() = std::move(s);
 				else
-					Content.addItem(std::move(*s));
+					Content.addItem(std::move(s));
+				++idx;
 			}
 			if (idx < Content.size())
 				Content.resizeList(idx);
@@ -212,6 +234,71 @@ void PlaylistEditor::update()
 			Content.refreshBorder();
 		}
 	}
+
+	prefetchContent();
+}
+
+void PlaylistEditor::clearContentCache()
+{
+	m_content_cache.clear();
+	// contents that are being fetched might be outdated
+	++m_content_cache_generation;
+}
+
+void PlaylistEditor::prefetchContent()
+{
+	// Wait until the cursor rests and content of the highlighted playlist is
+	// displayed. Only one request is sent at a time (and searches take
+	// precedence), so neighbours that are no longer relevant once the cursor
+	// moves are never requested.
+	if (m_prefetch_failed
+	    || MpdAsync.Busy()
+	    || Global::Timer - m_timer <= m_fetching_delay)
+		return;
+	ScopedUnfilteredMenu<MPD::Song> sunfilter_content(ReapplyFilter::No, Content);
+	if (Playlists.empty() || Content.empty())
+		return;
+	size_t current = Playlists.choice();
+	for (size_t distance = 1; distance <= PrefetchedNeighbours; ++distance)
+	{
+		for (size_t idx : { current + distance, current - distance })
+		{
+			// current - distance wraps around if it's negative
+			if (idx >= Playlists.size())
+				continue;
+			std::string path = Playlists[idx].value().path();
+			if (m_content_cache.contains(path))
+				continue;
+			auto songs = std::make_shared<std::vector<MPD::Song>>();
+			unsigned generation = m_content_cache_generation;
+			try
+			{
+				MpdAsync.GetPlaylistContent(
+					path,
+					[songs](std::vector<MPD::Song> &&chunk) {
+						std::move(chunk.begin(), chunk.end(), std::back_inserter(*songs));
+					},
+					[this, songs, path, generation](bool success) {
+						if (!success)
+						{
+							// Don't retry until the cursor moves.
+							m_prefetch_failed = true;
+						}
+						else if (generation == m_content_cache_generation)
+							m_content_cache.put(path, std::move(*songs));
+					});
+				// The user didn't ask for the content, so errors shouldn't be
+				// reported.
+				MpdAsync.IgnoreErrors();
+			}
+			catch (MPD::Error &)
+			{
+				// Don't retry until the cursor moves.
+				m_prefetch_failed = true;
+			}
+			return;
+		}
+	}
 }
 
 int PlaylistEditor::windowTimeout()
@@ -417,16 +504,13 @@ std::vector<MPD::Song> PlaylistEditor::getSelectedSongs()
 	if (isActiveWindow(Playlists))
 	{
 		bool any_selected = false;
-		for (auto &e : Playlists)
+		for (auto pos : Playlists.selectedPositions())
 		{
-			if (e.isSelected())
-			{
-				any_selected = true;
-				std::copy(
-					std::make_move_iterator(Mpd.GetPlaylistContent(e.value().path())),
-					std::make_move_iterator(MPD::SongIterator()),
-					std::back_inserter(result));
-			}
+			any_selected = true;
+			std::copy(
+				std::make_move_iterator(Mpd.GetPlaylistContent(Playlists[pos].value().path())),
+				std::make_move_iterator(MPD::SongIterator()),
+				std::back_inserter(result));
 		}
 		// if no item is selected, add songs from right column
 		ScopedUnfilteredMenu<MPD::Song> sunfilter_content(ReapplyFilter::No, Content);
@@ -489,6 +573,7 @@ void PlaylistEditor::nextColumn()
 void PlaylistEditor::updateTimer()
 {
 	m_timer = Global::Timer;
+	m_prefetch_failed = false;
 }
 
 void PlaylistEditor::locatePlaylist(const MPD::Playlist &playlist)
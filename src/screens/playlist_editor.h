@@ -27,6 +27,7 @@
 #include "regex_filter.h"
 #include "screens/screen.h"
 #include "song_list.h"
+#include "utility/lru_cache.h"
 
 struct PlaylistEditor: Screen<NC::Window *>, Filterable, HasColumns, HasSongs, Searchable, Tabbable
 {
@@ -77,6 +78,9 @@ struct PlaylistEditor: Screen<NC::Window *>, Filterable, HasColumns, HasSongs, S
 
 	void requestPlaylistsUpdate() { m_playlists_update_requested = true; }
 	void requestContentUpdate() { m_content_update_requested = true; }
+
+	/// Forgets contents of playlists fetched so far.
+	void clearContentCache();
 	
 	void locatePlaylist(const MPD::Playlist &playlist);
 	void locateSong(const MPD::Song &s);
@@ -85,6 +89,8 @@ struct PlaylistEditor: Screen<NC::Window *>, Filterable, HasColumns, HasSongs, S
 	SongMenu Content;
 	
 private:
+	void prefetchContent();
+
 	bool m_playlists_update_requested;
 	bool m_content_update_requested;
 
@@ -95,6 +101,11 @@ private:
 
 	Regex::Filter<MPD::Playlist> m_playlists_search_predicate;
 	Regex::Filter<MPD::Song> m_content_search_predicate;
+
+	// contents of recently displayed playlists and their neighbours
+	LRUCache<std::string, std::vector<MPD::Song>> m_content_cache;
+	unsigned m_content_cache_generation;
+	bool m_prefetch_failed;
 };
 
 extern PlaylistEditor *myPlaylistEditor;
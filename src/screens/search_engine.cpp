@@ -19,13 +19,19 @@
  ***************************************************************************/
 
 #include <array>
+#include <atomic>
 #include <boost/range/detail/any_iterator.hpp>
+#include <chrono>
+#include <exception>
 #include <iomanip>
+#include <mutex>
+#include <thread>
 
 #include "curses/menu_impl.h"
 #include "display.h"
 #include "global.h"
 #include "helpers.h"
+#include "library_snapshot.h"
 #include "screens/playlist.h"
 #include "screens/search_engine.h"
 #include "settings.h"
@@ -34,6 +40,7 @@
 #include "format_impl.h"
 #include "helpers/song_iterator_maker.h"
 #include "utility/comparators.h"
+#include "utility/fuzzy_match.h"
 #include "title.h"
 #include "screens/screen_switcher.h"
 
@@ -73,13 +80,310 @@ namespace pos {
 	const size_t reset = search+1;
 }*/
 
+// Tags corresponding to constraints other than "Any".
+const std::array<MPD::Song::GetFunction, 10> searchedTags = {{
+	&MPD::Song::getArtist,
+	&MPD::Song::getAlbumArtist,
+	&MPD::Song::getTitle,
+	&MPD::Song::getAlbum,
+	&MPD::Song::getName,
+	&MPD::Song::getComposer,
+	&MPD::Song::getPerformer,
+	&MPD::Song::getGenre,
+	&MPD::Song::getDate,
+	&MPD::Song::getComment
+}};
+
 std::string SEItemToString(const SEItem &ei);
 bool SEItemEntryMatcher(const Regex::Regex &rx,
                         const NC::Menu<SEItem>::Item &item,
                         bool filter);
 
+// Maximum number of results of fuzzy searches.
+const size_t FuzzyResultsLimit = 1000;
+
+// Orders matches by their score (best first) and drops the worst ones if there
+// is too many of them.
+template <typename T>
+void rankByScore(std::vector<std::pair<T, int>> &matches)
+{
+	std::stable_sort(matches.begin(), matches.end(),
+	                 [](const std::pair<T, int> &a, const std::pair<T, int> &b) {
+		                 return a.second > b.second;
+	                 });
+	if (matches.size() > FuzzyResultsLimit)
+		matches.erase(matches.begin() + FuzzyResultsLimit, matches.end());
+}
+
+// Checks songs against search constraints. Const member functions are safe to
+// call from multiple threads at once.
+class SongMatcher
+{
+public:
+	enum class Mode { Pattern, Exact, Fuzzy };
+
+	SongMatcher(const std::string *constraints, size_t constraints_number,
+	            Mode mode)
+	: m_constraints(constraints, constraints + constraints_number)
+	, m_rx(constraints_number)
+	, m_fuzzy(constraints_number)
+	, m_mode(mode)
+	, m_ignore_diacritics(Config.ignore_diacritics)
+	, m_cmp(std::locale(), Config.ignore_leading_the)
+	{
+		assert(constraints_number == searchedTags.size() + 1);
+		if (m_mode == Mode::Fuzzy)
+		{
+			for (size_t i = 0; i < m_constraints.size(); ++i)
+				m_fuzzy[i] = FuzzyPattern(m_constraints[i]);
+		}
+		else if (m_mode == Mode::Pattern)
+		{
+			for (size_t i = 0; i < m_constraints.size(); ++i)
+			{
+				if (!m_constraints[i].empty())
+				{
+					try
+					{
+						m_rx[i] = Regex::make(m_constraints[i], Config.regex_type);
+						const auto &literals = m_rx[i].literals();
+						m_literals.insert(m_literals.end(),
+						                  literals.begin(), literals.end());
+					}
+					catch (boost::bad_expression &) { }
+				}
+			}
+		}
+	}
+
+	Mode mode() const { return m_mode; }
+
+	/// @return true if the song matches, score is set to the score of the
+	/// match then (it's always 0 if the mode is other than fuzzy)
+	bool operator()(const MPD::Song &s, std::string &buffer, int &score) const
+	{
+		score = 0;
+		if (m_mode == Mode::Fuzzy)
+			return fuzzyMatches(s, buffer, score);
+
+		bool any_found = true, found = true;
+		if (!isEmpty(0))
+			any_found = std::any_of(searchedTags.begin(), searchedTags.end(),
+			                        [&](MPD::Song::GetFunction get) {
+				                        return matches(s, get, 0, buffer);
+			                        });
+		for (size_t i = 0; found && i < searchedTags.size(); ++i)
+			if (!isEmpty(i+1))
+				found = matches(s, searchedTags[i], i+1, buffer);
+		return any_found && found;
+	}
+
+	/// Substrings that values of searched tags need to contain for a song to
+	/// possibly match (each one in any of the tags).
+	const std::vector<std::string> &requiredLiterals() const
+	{
+		return m_literals;
+	}
+
+private:
+	bool fuzzyMatches(const MPD::Song &s, std::string &buffer, int &score) const
+	{
+		int tag_score;
+		if (!m_fuzzy[0].empty())
+		{
+			// The best matching tag counts.
+			bool found = false;
+			int best = 0;
+			for (const auto &get : searchedTags)
+			{
+				if (m_fuzzy[0].match(s.getRef(get, 0, buffer), tag_score))
+				{
+					best = found ? std::max(best, tag_score) : tag_score;
+					found = true;
+				}
+			}
+			if (!found)
+				return false;
+			score += best;
+		}
+		for (size_t i = 0; i < searchedTags.size(); ++i)
+		{
+			if (m_fuzzy[i+1].empty())
+				continue;
+			if (!m_fuzzy[i+1].match(s.getRef(searchedTags[i], 0, buffer), tag_score))
+				return false;
+			score += tag_score;
+		}
+		return true;
+	}
+
+	bool matches(const MPD::Song &s, MPD::Song::GetFunction get,
+	             size_t constraint, std::string &buffer) const
+	{
+		// tag values are only referenced, not copied
+		if (m_mode == Mode::Pattern)
+		{
+			// values come with diacritics already stripped
+			if (m_ignore_diacritics)
+				return Regex::search(s.getStrippedRef(get, 0, buffer),
+				                     m_rx[constraint], false);
+			return Regex::search(s.getRef(get, 0, buffer), m_rx[constraint], false);
+		}
+		else // match only if values are equal
+			return !m_cmp(s.getRef(get, 0, buffer), m_constraints[constraint]);
+	}
+
+	bool isEmpty(size_t constraint) const
+	{
+		return m_mode == Mode::Pattern
+			? m_rx[constraint].empty()
+			: m_constraints[constraint].empty();
+	}
+
+	std::vector<std::string> m_constraints;
+	std::vector<Regex::Regex> m_rx;
+	std::vector<FuzzyPattern> m_fuzzy;
+	std::vector<std::string> m_literals;
+	Mode m_mode;
+	bool m_ignore_diacritics;
+	LocaleStringComparison m_cmp;
+};
+
 }
 
+// Regex or fuzzy search over a snapshot of the library, split between worker
+// threads. Workers pick up blocks of songs one at a time and store indices of
+// matching songs per block, so that the results can be handed out in library
+// order as soon as all preceding blocks are done (or ranked by score once the
+// whole search is done).
+struct SearchEngine::LibrarySearch
+{
+	static const size_t BlockSize = 1024;
+
+	LibrarySearch(std::vector<MPD::Song> songs, size_t library_size,
+	              size_t index_size, SongMatcher matcher)
+	: m_songs(std::move(songs))
+	, m_library_size(library_size)
+	, m_index_size(index_size)
+	, m_matcher(std::move(matcher))
+	, m_matches((m_songs.size() + BlockSize - 1) / BlockSize)
+	, m_done(m_matches.size())
+	, m_next_block(0)
+	, m_searched(0)
+	, m_matched(0)
+	, m_cancelled(false)
+	, m_start(std::chrono::steady_clock::now())
+	, m_taken_blocks(0)
+	{
+		size_t threads = std::max(std::thread::hardware_concurrency(), 1u);
+		threads = std::min(threads, std::max(m_matches.size(), size_t(1)));
+		m_running = threads;
+		for (size_t i = 0; i < threads; ++i)
+			m_workers.emplace_back(&LibrarySearch::work, this);
+	}
+
+	~LibrarySearch()
+	{
+		cancel();
+		for (auto &worker : m_workers)
+			worker.join();
+	}
+
+	void cancel() { m_cancelled = true; }
+	bool finished() const { return m_running == 0; }
+
+	size_t searched() const { return m_searched; }
+	size_t matched() const { return m_matched; }
+	/// Number of songs in the library, including the ones filtered out by
+	/// the trigram index.
+	size_t librarySize() const { return m_library_size; }
+	/// Memory used by the trigram index (0 if it wasn't used).
+	size_t indexSize() const { return m_index_size; }
+	std::chrono::steady_clock::duration elapsed() const
+	{
+		return std::chrono::steady_clock::now() - m_start;
+	}
+
+	/// @return results that weren't taken yet and can already be shown
+	std::vector<MPD::Song> takeResults()
+	{
+		if (finished() && m_error)
+			std::rethrow_exception(m_error);
+		bool fuzzy = m_matcher.mode() == SongMatcher::Mode::Fuzzy;
+		std::vector<std::pair<size_t, int>> matches;
+		if (!fuzzy || finished())
+		{
+			for (; m_taken_blocks < m_matches.size() && m_done[m_taken_blocks];
+			     ++m_taken_blocks)
+			{
+				const auto &block = m_matches[m_taken_blocks];
+				matches.insert(matches.end(), block.begin(), block.end());
+			}
+		}
+		if (fuzzy)
+			rankByScore(matches);
+		std::vector<MPD::Song> result;
+		result.reserve(matches.size());
+		for (const auto &match : matches)
+			result.push_back(m_songs[match.first]);
+		return result;
+	}
+
+private:
+	void work()
+	{
+		try
+		{
+			std::string buffer;
+			int score;
+			while (!m_cancelled)
+			{
+				size_t block = m_next_block++;
+				if (block >= m_matches.size())
+					break;
+				size_t first = block * BlockSize;
+				size_t last = std::min(first + BlockSize, m_songs.size());
+				for (size_t i = first; i < last; ++i)
+					if (m_matcher(m_songs[i], buffer, score))
+						m_matches[block].emplace_back(i, score);
+				m_matched += m_matches[block].size();
+				m_searched += last - first;
+				m_done[block] = true;
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_error_mutex);
+			if (!m_error)
+				m_error = std::current_exception();
+			m_cancelled = true;
+		}
+		--m_running;
+	}
+
+	const std::vector<MPD::Song> m_songs;
+	const size_t m_library_size;
+	const size_t m_index_size;
+	const SongMatcher m_matcher;
+
+	std::vector<std::vector<std::pair<size_t, int>>> m_matches;
+	std::vector<std::atomic<bool>> m_done;
+	std::atomic<size_t> m_next_block;
+	std::atomic<size_t> m_searched;
+	std::atomic<size_t> m_matched;
+	std::atomic<size_t> m_running;
+	std::atomic<bool> m_cancelled;
+
+	std::mutex m_error_mutex;
+	std::exception_ptr m_error;
+
+	std::chrono::steady_clock::time_point m_start;
+	std::vector<std::thread> m_workers;
+
+	// Accessed only by the main thread.
+	size_t m_taken_blocks;
+};
+
 template <>
 struct SongPropertiesExtractor<SEItem>
 {
@@ -129,13 +433,11 @@ ConstSongIterator SearchEngineWindow::endS() const
 std::vector<MPD::Song> SearchEngineWindow::getSelectedSongs()
 {
 	std::vector<MPD::Song> result;
-	for (auto &item : *this)
+	for (auto pos : selectedPositions())
 	{
-		if (item.isSelected())
-		{
-			assert(item.value().isSong());
-			result.push_back(item.value().song());
-		}
+		auto &item = (*this)[pos];
+		assert(item.value().isSong());
+		result.push_back(item.value().song());
 	}
 	// If no item is selected, add the current one if it's a song.
 	if (result.empty() && !empty() && current()->value().isSong())
@@ -165,6 +467,7 @@ const char *SearchEngine::SearchModes[] =
 	"Match if tag contains searched phrase (no regexes)",
 	"Match if tag contains searched phrase (regexes supported)",
 	"Match only if both values are the same",
+	"Match fuzzily (best matches first)",
 	0
 };
 
@@ -174,6 +477,7 @@ size_t SearchEngine::SearchButton = 15;
 
 SearchEngine::SearchEngine()
 : Screen(NC::Menu<SEItem>(0, MainStartY, COLS, MainHeight, "", Config.main_color, NC::Border()))
+, m_search_in_progress(false)
 {
 	setHighlightFixes(w);
 	w.cyclicScrolling(Config.use_cyclic_scrolling);
@@ -216,6 +520,53 @@ std::wstring SearchEngine::title()
 	return L"Search engine";
 }
 
+void SearchEngine::update()
+{
+	if (!m_library_search)
+		return;
+
+	// Reset the search before taking the final results as they may rethrow an
+	// exception that was thrown by one of the workers.
+	auto search = m_library_search;
+	bool finished = search->finished();
+	if (finished)
+		m_library_search.reset();
+
+	auto songs = search->takeResults();
+	for (auto &s : songs)
+		w.addItem(std::move(s));
+
+	if (finished)
+	{
+		using namespace std::chrono;
+		auto ms = duration_cast<milliseconds>(search->elapsed()).count();
+		auto rate = search->librarySize() * 1000 / std::max<decltype(ms)>(ms, 1);
+		auto stats = boost::str(
+			boost::format(" (%1% of %2% songs checked in %3% ms, %4% songs/s")
+			% search->searched() % search->librarySize() % ms % rate);
+		if (search->indexSize() > 0)
+			stats += boost::str(
+				boost::format(", index: %1% B/song")
+				% (search->indexSize() / std::max<size_t>(search->librarySize(), 1)));
+		finishSearch(stats + ")");
+	}
+	else
+		Statusbar::printf("Searching... %1% matches / %2% of %3% songs checked",
+		                  search->matched(), search->searched(), search->librarySize());
+
+	if ((finished || !songs.empty()) && isVisible(this))
+		w.refresh();
+}
+
+int SearchEngine::windowTimeout()
+{
+	// Poll frequently for results of the search running in the background.
+	if (m_library_search)
+		return 100;
+	else
+		return Screen<WindowType>::windowTimeout();
+}
+
 void SearchEngine::mouseButtonPressed(MEVENT me)
 {
 	if (w.empty() || !w.hasCoords(me.x, me.y) || size_t(me.y) >= w.size())
@@ -332,6 +683,11 @@ void SearchEngine::runAction()
 			SearchMode = &SearchModes[0];
 		w.current()->value().buffer() << NC::Format::Bold << "Search mode:" << NC::Format::NoBold << ' ' << *SearchMode;
 	}
+	else if (option == SearchButton && isSearching())
+	{
+		// Activating the button again stops the search in progress.
+		stopSearching();
+	}
 	else if (option == SearchButton)
 	{
 		w.clearFilter();
@@ -339,33 +695,6 @@ void SearchEngine::runAction()
 		if (w.size() > StaticOptions)
 			Prepare();
 		Search();
-		if (w.rbegin()->value().isSong())
-		{
-			if (Config.search_engine_display_mode == DisplayMode::Columns)
-				w.setTitle(Config.titles_visibility ? Display::Columns(w.getWidth()) : "");
-			size_t found = w.size()-SearchEngine::StaticOptions;
-			found += 3; // don't count options inserted below
-			w.insertSeparator(ResetButton+1);
-			w.insertItem(ResetButton+2, SEItem(), NC::List::Properties::Inactive);
-			w.at(ResetButton+2).value().mkBuffer()
-				<< NC::Format::Bold
-				<< Config.color1
-				<< "Search results: "
-				<< NC::FormattedColor::End<>(Config.color1)
-				<< Config.color2
-				<< "Found " << found << (found > 1 ? " songs" : " song")
-				<< NC::FormattedColor::End<>(Config.color2)
-				<< NC::Format::NoBold;
-			w.insertSeparator(ResetButton+3);
-				Statusbar::print("Searching finished");
-			if (Config.block_search_constraints_change)
-				for (size_t i = 0; i < StaticOptions-4; ++i)
-					w.at(i).setInactive(true);
-			w.scroll(NC::Scroll::Down);
-			w.scroll(NC::Scroll::Down);
-		}
-		else
-			Statusbar::print("No results found");
 	}
 	else if (option == ResetButton)
 	{
@@ -423,6 +752,7 @@ void SearchEngine::Prepare()
 
 void SearchEngine::reset()
 {
+	cancelSearch();
 	for (size_t i = 0; i < ConstraintsNumber; ++i)
 		itsConstraints[i].clear();
 	w.clearFilter();
@@ -433,6 +763,8 @@ void SearchEngine::reset()
 
 void SearchEngine::Search()
 {
+	cancelSearch();
+
 	bool constraints_empty = 1;
 	for (size_t i = 0; i < ConstraintsNumber; ++i)
 	{
@@ -443,52 +775,89 @@ void SearchEngine::Search()
 		}
 	}
 	if (constraints_empty)
+	{
+		finishSearch();
 		return;
+	}
 	
 	if (Config.search_in_db && (SearchMode == &SearchModes[0] || SearchMode == &SearchModes[2])) // use built-in mpd searching
 	{
-		Mpd.StartSearch(SearchMode == &SearchModes[2]);
+		MpdAsync.StartSearch(SearchMode == &SearchModes[2]);
 		if (!itsConstraints[0].empty())
-			Mpd.AddSearchAny(itsConstraints[0]);
+			MpdAsync.AddSearchAny(itsConstraints[0]);
 		if (!itsConstraints[1].empty())
-			Mpd.AddSearch(MPD_TAG_ARTIST, itsConstraints[1]);
+			MpdAsync.AddSearch(MPD_TAG_ARTIST, itsConstraints[1]);
 		if (!itsConstraints[2].empty())
-			Mpd.AddSearch(MPD_TAG_ALBUM_ARTIST, itsConstraints[2]);
+			MpdAsync.AddSearch(MPD_TAG_ALBUM_ARTIST, itsConstraints[2]);
 		if (!itsConstraints[3].empty())
-			Mpd.AddSearch(MPD_TAG_TITLE, itsConstraints[3]);
+			MpdAsync.AddSearch(MPD_TAG_TITLE, itsConstraints[3]);
 		if (!itsConstraints[4].empty())
-			Mpd.AddSearch(MPD_TAG_ALBUM, itsConstraints[4]);
+			MpdAsync.AddSearch(MPD_TAG_ALBUM, itsConstraints[4]);
 		if (!itsConstraints[5].empty())
-			Mpd.AddSearchURI(itsConstraints[5]);
+			MpdAsync.AddSearchURI(itsConstraints[5]);
 		if (!itsConstraints[6].empty())
-			Mpd.AddSearch(MPD_TAG_COMPOSER, itsConstraints[6]);
+			MpdAsync.AddSearch(MPD_TAG_COMPOSER, itsConstraints[6]);
 		if (!itsConstraints[7].empty())
-			Mpd.AddSearch(MPD_TAG_PERFORMER, itsConstraints[7]);
+			MpdAsync.AddSearch(MPD_TAG_PERFORMER, itsConstraints[7]);
 		if (!itsConstraints[8].empty())
-			Mpd.AddSearch(MPD_TAG_GENRE, itsConstraints[8]);
+			MpdAsync.AddSearch(MPD_TAG_GENRE, itsConstraints[8]);
 		if (!itsConstraints[9].empty())
-			Mpd.AddSearch(MPD_TAG_DATE, itsConstraints[9]);
+			MpdAsync.AddSearch(MPD_TAG_DATE, itsConstraints[9]);
 		if (!itsConstraints[10].empty())
-			Mpd.AddSearch(MPD_TAG_COMMENT, itsConstraints[10]);
-		for (MPD::SongIterator s = Mpd.CommitSearchSongs(), end; s != end; ++s)
-			w.addItem(std::move(*s));
+			MpdAsync.AddSearch(MPD_TAG_COMMENT, itsConstraints[10]);
+		// Results of the search are received in the background and appended as
+		// they arrive so that huge responses don't freeze the interface.
+		MpdAsync.CommitSearchSongs(
+			[this](std::vector<MPD::Song> &&songs) {
+				for (auto &s : songs)
+					w.addItem(std::move(s));
+				Statusbar::printf("Searching... %1% matches",
+				                  w.size() - (StaticOptions - 3));
+				if (isVisible(this))
+					w.refresh();
+			},
+			[this](bool) {
+				m_search_in_progress = false;
+				finishSearch();
+				if (isVisible(this))
+					w.refresh();
+			});
+		m_search_in_progress = true;
 		return;
 	}
 
-	Regex::Regex rx[ConstraintsNumber];
-	if (SearchMode != &SearchModes[2]) // match to pattern
+	auto mode = SongMatcher::Mode::Pattern;
+	if (SearchMode == &SearchModes[2])
+		mode = SongMatcher::Mode::Exact;
+	else if (SearchMode == &SearchModes[3])
+		mode = SongMatcher::Mode::Fuzzy;
+	SongMatcher matcher(itsConstraints, ConstraintsNumber, mode);
+
+	if (Config.search_in_db) // local search over a copy of the library
 	{
-		for (size_t i = 0; i < ConstraintsNumber; ++i)
+		const auto &songs = Library.songs();
+		std::vector<MPD::Song> candidates;
+		size_t index_size = 0;
+		if (Config.search_engine_trigram_index
+		    && !matcher.requiredLiterals().empty())
 		{
-			if (!itsConstraints[i].empty())
+			const auto &index = Library.trigrams(
+				TrigramIndex::TagList(searchedTags.begin(), searchedTags.end()),
+				Config.ignore_diacritics);
+			std::vector<uint32_t> positions;
+			if (index.candidates(matcher.requiredLiterals(), positions))
 			{
-				try
-				{
-					rx[i] = Regex::make(itsConstraints[i], Config.regex_type);
-				}
-				catch (boost::bad_expression &) { }
+				candidates.reserve(positions.size());
+				for (auto pos : positions)
+					candidates.push_back(songs[pos]);
+				index_size = index.memoryUsage();
 			}
 		}
+		if (index_size == 0)
+			candidates = songs;
+		m_library_search = std::make_shared<LibrarySearch>(
+			std::move(candidates), songs.size(), index_size, std::move(matcher));
+		return;
 	}
 
 	typedef boost::range_detail::any_iterator<
@@ -498,10 +867,13 @@ void SearchEngine::Search()
 		std::ptrdiff_t
 	> input_song_iterator;
 	input_song_iterator s, end;
-	if (Config.search_in_db)
+	std::vector<MPD::Song> playlist;
+	if (!std::all_of(searchedTags.begin(), searchedTags.end(), isTagTypeEnabled))
 	{
-		s = input_song_iterator(Mpd.GetDirectoryRecursive("/"));
-		end = input_song_iterator(MPD::SongIterator());
+		// some of the searched tags were not fetched along with the playlist
+		playlist = fetchPlaylistWithAllTags();
+		s = input_song_iterator(playlist.cbegin());
+		end = input_song_iterator(playlist.cend());
 	}
 	else
 	{
@@ -509,86 +881,72 @@ void SearchEngine::Search()
 		end = input_song_iterator(myPlaylist->main().endV());
 	}
 
-	LocaleStringComparison cmp(std::locale(), Config.ignore_leading_the);
+	std::string buffer;
+	int score;
+	std::vector<std::pair<MPD::Song, int>> matches;
 	for (; s != end; ++s)
+		if (matcher(*s, buffer, score))
+			matches.emplace_back(*s, score);
+	if (mode == SongMatcher::Mode::Fuzzy)
+		rankByScore(matches);
+	for (auto &match : matches)
+		w.addItem(std::move(match.first));
+	finishSearch();
+}
+
+bool SearchEngine::isSearching() const
+{
+	return m_search_in_progress || m_library_search;
+}
+
+void SearchEngine::stopSearching()
+{
+	cancelSearch();
+	finishSearch(" (cancelled)");
+	if (isVisible(this))
+		w.refresh();
+}
+
+void SearchEngine::cancelSearch()
+{
+	if (m_search_in_progress)
 	{
-		bool any_found = true, found = true;
+		MpdAsync.Cancel();
+		m_search_in_progress = false;
+	}
+	// Waits for the workers to notice, which takes at most one block of songs.
+	m_library_search.reset();
+}
 
-		if (SearchMode != &SearchModes[2]) // match to pattern
-		{
-			if (!rx[0].empty())
-				any_found =
-					   Regex::search(s->getArtist(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getAlbumArtist(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getTitle(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getAlbum(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getName(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getComposer(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getPerformer(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getGenre(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getDate(), rx[0], Config.ignore_diacritics)
-					|| Regex::search(s->getComment(), rx[0], Config.ignore_diacritics);
-			if (found && !rx[1].empty())
-				found = Regex::search(s->getArtist(), rx[1], Config.ignore_diacritics);
-			if (found && !rx[2].empty())
-				found = Regex::search(s->getAlbumArtist(), rx[2], Config.ignore_diacritics);
-			if (found && !rx[3].empty())
-				found = Regex::search(s->getTitle(), rx[3], Config.ignore_diacritics);
-			if (found && !rx[4].empty())
-				found = Regex::search(s->getAlbum(), rx[4], Config.ignore_diacritics);
-			if (found && !rx[5].empty())
-				found = Regex::search(s->getName(), rx[5], Config.ignore_diacritics);
-			if (found && !rx[6].empty())
-				found = Regex::search(s->getComposer(), rx[6], Config.ignore_diacritics);
-			if (found && !rx[7].empty())
-				found = Regex::search(s->getPerformer(), rx[7], Config.ignore_diacritics);
-			if (found && !rx[8].empty())
-				found = Regex::search(s->getGenre(), rx[8], Config.ignore_diacritics);
-			if (found && !rx[9].empty())
-				found = Regex::search(s->getDate(), rx[9], Config.ignore_diacritics);
-			if (found && !rx[10].empty())
-				found = Regex::search(s->getComment(), rx[10], Config.ignore_diacritics);
-		}
-		else // match only if values are equal
-		{
-			if (!itsConstraints[0].empty())
-				any_found =
-				   !cmp(s->getArtist(), itsConstraints[0])
-				|| !cmp(s->getAlbumArtist(), itsConstraints[0])
-				|| !cmp(s->getTitle(), itsConstraints[0])
-				|| !cmp(s->getAlbum(), itsConstraints[0])
-				|| !cmp(s->getName(), itsConstraints[0])
-				|| !cmp(s->getComposer(), itsConstraints[0])
-				|| !cmp(s->getPerformer(), itsConstraints[0])
-				|| !cmp(s->getGenre(), itsConstraints[0])
-				|| !cmp(s->getDate(), itsConstraints[0])
-				|| !cmp(s->getComment(), itsConstraints[0]);
-			
-			if (found && !itsConstraints[1].empty())
-				found = !cmp(s->getArtist(), itsConstraints[1]);
-			if (found && !itsConstraints[2].empty())
-				found = !cmp(s->getAlbumArtist(), itsConstraints[2]);
-			if (found && !itsConstraints[3].empty())
-				found = !cmp(s->getTitle(), itsConstraints[3]);
-			if (found && !itsConstraints[4].empty())
-				found = !cmp(s->getAlbum(), itsConstraints[4]);
-			if (found && !itsConstraints[5].empty())
-				found = !cmp(s->getName(), itsConstraints[5]);
-			if (found && !itsConstraints[6].empty())
-				found = !cmp(s->getComposer(), itsConstraints[6]);
-			if (found && !itsConstraints[7].empty())
-				found = !cmp(s->getPerformer(), itsConstraints[7]);
-			if (found && !itsConstraints[8].empty())
-				found = !cmp(s->getGenre(), itsConstraints[8]);
-			if (found && !itsConstraints[9].empty())
-				found = !cmp(s->getDate(), itsConstraints[9]);
-			if (found && !itsConstraints[10].empty())
-				found = !cmp(s->getComment(), itsConstraints[10]);
-		}
-		
-		if (any_found && found)
-			w.addItem(*s);
+void SearchEngine::finishSearch(const std::string &stats)
+{
+	if (w.rbegin()->value().isSong())
+	{
+		if (Config.search_engine_display_mode == DisplayMode::Columns)
+			w.setTitle(Config.titles_visibility ? Display::Columns(w.getWidth()) : "");
+		size_t found = w.size()-SearchEngine::StaticOptions;
+		found += 3; // don't count options inserted below
+		w.insertSeparator(ResetButton+1);
+		w.insertItem(ResetButton+2, SEItem(), NC::List::Properties::Inactive);
+		w.at(ResetButton+2).value().mkBuffer()
+			<< NC::Format::Bold
+			<< Config.color1
+			<< "Search results: "
+			<< NC::FormattedColor::End<>(Config.color1)
+			<< Config.color2
+			<< "Found " << found << (found > 1 ? " songs" : " song")
+			<< NC::FormattedColor::End<>(Config.color2)
+			<< NC::Format::NoBold;
+		w.insertSeparator(ResetButton+3);
+		Statusbar::printf("Searching finished%1%", stats);
+		if (Config.block_search_constraints_change)
+			for (size_t i = 0; i < StaticOptions-4; ++i)
+				w.at(i).setInactive(true);
+		w.scroll(NC::Scroll::Down);
+		w.scroll(NC::Scroll::Down);
 	}
+	else
+		Statusbar::printf("No results found%1%", stats);
 }
 
 namespace {
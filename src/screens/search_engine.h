@@ -22,6 +22,7 @@
 #define NCMPCPP_SEARCH_ENGINE_H
 
 #include <cassert>
+#include <memory>
 
 #include "interfaces.h"
 #include "mpdpp.h"
@@ -102,7 +103,8 @@ struct SearchEngine: Screen<SearchEngineWindow>, Filterable, HasActions, HasSong
 	virtual std::wstring title() override;
 	virtual ScreenType type() override { return ScreenType::SearchEngine; }
 	
-	virtual void update() override { }
+	virtual void update() override;
+	virtual int windowTimeout() override;
 	
 	virtual void mouseButtonPressed(MEVENT me) override;
 	
@@ -132,6 +134,11 @@ struct SearchEngine: Screen<SearchEngineWindow>, Filterable, HasActions, HasSong
 	
 	// private members
 	void reset();
+
+	/// @return true if results of the search are still being received
+	bool isSearching() const;
+	/// Stops the search in progress, keeping results received so far.
+	void stopSearching();
 	
 	static size_t StaticOptions;
 	static size_t SearchButton;
@@ -140,8 +147,14 @@ struct SearchEngine: Screen<SearchEngineWindow>, Filterable, HasActions, HasSong
 private:
 	void Prepare();
 	void Search();
+	void cancelSearch();
+	void finishSearch(const std::string &stats = "");
+
+	struct LibrarySearch;
 
 	Regex::ItemFilter<SEItem> m_search_predicate;
+	bool m_search_in_progress;
+	std::shared_ptr<LibrarySearch> m_library_search;
 	
 	const char **SearchMode;
 	
@@ -253,7 +253,7 @@ void SelectedItemsAdder::populatePlaylistSelector(BaseScreen *old_screen)
 				std::bind(&Self::addToExistingPlaylist, this, it->path())
 			));
 		};
-		std::sort(m_playlist_selector.beginV()+begin, m_playlist_selector.endV(),
+		sortByKeyOf(m_playlist_selector.beginV()+begin, m_playlist_selector.endV(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		if (begin < m_playlist_selector.size())
 			m_playlist_selector.addSeparator();
@@ -54,11 +54,15 @@ void ServerInfo::switchTo()
 		);
 
 		m_tag_types.clear();
-		std::copy(
-			std::make_move_iterator(Mpd.GetTagTypes()),
-			std::make_move_iterator(MPD::StringIterator()),
-			std::back_inserter(m_tag_types)
-		);
+		{
+			// list all tags supported by the server, not only the enabled ones
+			MPD::ScopedTagTypes all_tags(Mpd, {});
+			std::copy(
+				std::make_move_iterator(Mpd.GetTagTypes()),
+				std::make_move_iterator(MPD::StringIterator()),
+				std::back_inserter(m_tag_types)
+			);
+		}
 	}
 	else
 		switchToPreviousScreen();
@@ -82,7 +82,7 @@ void SongInfo::switchTo()
 		SwitchTo::execute(this);
 		w.clear();
 		w.reset();
-		PrepareSong(*s);
+		PrepareSong(fetchAllTags(*s));
 		w.flush();
 		// redraw header after we're done with the file, since reading it from disk
 		// takes a bit of time and having header updated before content of a window
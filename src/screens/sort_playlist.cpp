@@ -18,6 +18,8 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <numeric>
+
 #include "curses/menu_impl.h"
 #include "charset.h"
 #include "display.h"
@@ -172,50 +174,49 @@ void SortPlaylistDialog::sort() const
 		return;
 
 	size_t start_pos = begin - pl.begin();
-	std::vector<MPD::Song> playlist;
-	playlist.reserve(end - begin);
-	for (; begin != end; ++begin)
-		playlist.push_back(begin->value());
-	
-	typedef std::vector<MPD::Song>::iterator Iterator;
+	size_t length = end - begin;
+
+	// Extract tags used for sorting once, so that comparisons only need to
+	// look at already computed keys.
+	std::vector<MPD::Song::GetFunction> fields;
+	for (auto it = w.beginV(); it->item().second; ++it)
+		fields.push_back(it->item().second);
+	std::vector<std::string> keys;
+	keys.reserve(length * fields.size());
+	if (std::all_of(fields.begin(), fields.end(), isTagTypeEnabled))
+	{
+		for (; begin != end; ++begin)
+			for (const auto &f : fields)
+				keys.push_back(begin->value().getTags(f));
+	}
+	else
+	{
+		// tags used for sorting were not fetched along with the playlist
+		auto songs = fetchPlaylistWithAllTags();
+		if (songs.size() < start_pos + length)
+			return;
+		for (size_t i = start_pos; i < start_pos + length; ++i)
+			for (const auto &f : fields)
+				keys.push_back(songs[i].getTags(f));
+	}
+
+	// Sort the range locally (stable sort preserves positions of songs that
+	// compare equal) and then apply the resulting permutation in one go.
 	LocaleStringComparison cmp(std::locale(), Config.ignore_leading_the);
-	std::function<void(Iterator, Iterator)> iter_swap, quick_sort;
-	auto song_cmp = [this, &cmp](const MPD::Song &a, const MPD::Song &b) -> bool {
-		for (auto it = w.beginV();  it->item().second; ++it)
+	std::vector<size_t> order(length);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		for (size_t i = 0; i < fields.size(); ++i)
 		{
-			int res = cmp(a.getTags(it->item().second),
-			              b.getTags(it->item().second));
+			int res = cmp(keys[a*fields.size()+i], keys[b*fields.size()+i]);
 			if (res != 0)
 				return res < 0;
 		}
-		return a.getPosition() < b.getPosition();
-	};
-	iter_swap = [&playlist, &start_pos](Iterator a, Iterator b) {
-		std::iter_swap(a, b);
-		Mpd.Swap(start_pos+a-playlist.begin(), start_pos+b-playlist.begin());
-	};
-	quick_sort = [&song_cmp, &quick_sort, &iter_swap](Iterator first, Iterator last) {
-		if (last-first > 1)
-		{
-			Iterator pivot = first+Global::RNG()%(last-first);
-			iter_swap(pivot, last-1);
-			pivot = last-1;
-			
-			Iterator tmp = first;
-			for (Iterator i = first; i != pivot; ++i)
-				if (song_cmp(*i, *pivot))
-					iter_swap(i, tmp++);
-			iter_swap(tmp, pivot);
-			
-			quick_sort(first, tmp);
-			quick_sort(tmp+1, last);
-		}
-	};
-	
+		return false;
+	});
+
 	Statusbar::print("Sorting...");
-	Mpd.StartCommandsList();
-	quick_sort(playlist.begin(), playlist.end());
-	Mpd.CommitCommandsList();
+	reorderPlaylist(start_pos, order);
 	Statusbar::print("Range sorted");
 	switchToPreviousScreen();
 }
@@ -288,7 +288,7 @@ void TagEditor::update()
 			if (directory->path() == itsHighlightedDir)
 				Dirs->highlight(Dirs->size()-1);
 		};
-		std::sort(Dirs->beginV()+1, Dirs->endV(),
+		sortByKeyOf(Dirs->beginV()+1, Dirs->endV(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		Dirs->display();
 	}
@@ -296,10 +296,12 @@ void TagEditor::update()
 	if (Tags->empty())
 	{
 		Tags->reset();
+		// all tags are written back to files, so fetch them all
+		MPD::ScopedTagTypes all_tags(Mpd, {});
 		MPD::SongIterator s = Mpd.GetSongs(Dirs->current()->value().second), end;
 		for (; s != end; ++s)
 			Tags->addItem(std::move(*s));
-		std::sort(Tags->beginV(), Tags->endV(),
+		sortByKeyOf(Tags->beginV(), Tags->endV(),
 			LocaleBasedSorting(std::locale(), Config.ignore_leading_the));
 		Tags->refresh();
 	}
@@ -695,11 +697,10 @@ void TagEditor::runAction()
 
 	EditedSongs.clear();
 	// if there are selected songs, perform operations only on them
-	if (hasSelected(Tags->begin(), Tags->end()))
+	if (Tags->hasSelected())
 	{
-		for (auto it = Tags->begin(); it != Tags->end(); ++it)
-			if (it->isSelected())
-				EditedSongs.push_back(&it->value());
+		for (auto pos : Tags->selectedPositions())
+			EditedSongs.push_back(&(*Tags)[pos].value());
 	}
 	else
 	{
@@ -843,9 +844,8 @@ std::vector<MPD::Song> TagEditor::getSelectedSongs()
 	std::vector<MPD::Song> result;
 	if (w == Tags)
 	{
-		for (auto it = Tags->begin(); it != Tags->end(); ++it)
-			if (it->isSelected())
-				result.push_back(it->value());
+		for (auto pos : Tags->selectedPositions())
+			result.push_back((*Tags)[pos].value());
 		// if no song was selected, add current one
 		if (result.empty() && !Tags->empty())
 			result.push_back(Tags->current()->value());
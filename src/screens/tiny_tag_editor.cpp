@@ -186,7 +186,7 @@ void TinyTagEditor::SetEdited(const MPD::Song &s)
 	if (auto ms = dynamic_cast<const MPD::MutableSong *>(&s))
 		itsEdited = *ms;
 	else
-		itsEdited = s;
+		itsEdited = fetchAllTags(s);
 }
 
 bool TinyTagEditor::getTags()
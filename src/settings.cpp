@@ -252,6 +252,8 @@ bool Configuration::read(const std::vector<std::string> &config_paths, bool igno
 	p.add("mpd_connection_timeout", &mpd_connection_timeout, "5");
 	p.add("mpd_crossfade_time", &crossfade_time, "5");
 	p.add("random_exclude_pattern", &random_exclude_pattern, "");
+	p.add("library_snapshot", &library_snapshot, "yes", yes_no);
+	p.add("restrict_tag_types", &restrict_tag_types, "no", yes_no);
 	p.add("visualizer_data_source", &visualizer_data_source, "/tmp/mpd.fifo", adjust_path);
 	p.add("visualizer_output_name", &visualizer_output_name, "Visualizer feed");
 	p.add("visualizer_in_stereo", &visualizer_in_stereo, "yes", yes_no);
@@ -465,6 +467,7 @@ bool Configuration::read(const std::vector<std::string> &config_paths, bool igno
 				invalid_value(v);
 		});
 	p.add("media_library_albums_split_by_date", &media_library_albums_split_by_date, "yes", yes_no);
+	p.add("media_library_index", &media_library_index, "yes", yes_no);
 	p.add("default_find_mode", &wrapped_search, "wrapped", [](std::string v) {
 			if (v == "wrapped")
 				return true;
@@ -567,6 +570,7 @@ bool Configuration::read(const std::vector<std::string> &config_paths, bool igno
 	p.add("ignore_diacritics", &ignore_diacritics, "no", yes_no);
 	p.add("block_search_constraints_change_if_items_found",
 	      &block_search_constraints_change, "yes", yes_no);
+	p.add("incremental_search_delay", &incremental_search_delay, "100");
 	p.add("mouse_support", &mouse_support, "yes", yes_no);
 	p.add("mouse_list_scroll_whole_page", &mouse_list_scroll_whole_page, "no", yes_no);
 	p.add("lines_scrolled", &lines_scrolled, "5");
@@ -591,9 +595,10 @@ bool Configuration::read(const std::vector<std::string> &config_paths, bool igno
 	p.add("search_engine_default_search_mode", &search_engine_default_search_mode,
 	      "1", [](std::string v) {
 		      auto mode = verbose_lexical_cast<unsigned>(v);
-		      boundsCheck<unsigned>(mode, 1, 3);
+		      boundsCheck<unsigned>(mode, 1, 4);
 		      return --mode;
 	      });
+	p.add("search_engine_trigram_index", &search_engine_trigram_index, "yes", yes_no);
 	p.add("external_editor", &external_editor, "nano", adjust_path);
 	p.add("use_console_editor", &use_console_editor, "yes", yes_no);
 	p.add("colors_enabled", &colors_enabled, "yes", yes_no);
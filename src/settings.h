@@ -163,6 +163,8 @@ struct Configuration
 	bool fetch_lyrics_in_background;
 	bool local_browser_show_hidden_files;
 	bool search_in_db;
+	bool library_snapshot;
+	bool restrict_tag_types;
 	bool jump_to_now_playing_song_at_start;
 	bool clock_display_seconds;
 	bool display_volume_level;
@@ -188,6 +190,8 @@ struct Configuration
 	bool ask_for_locked_screen_width_part;
 	bool allow_for_physical_item_deletion;
 	bool media_library_albums_split_by_date;
+	bool media_library_index;
+	bool search_engine_trigram_index;
 	bool startup_slave_screen_focus;
 
 	unsigned mpd_connection_timeout;
@@ -197,6 +201,7 @@ struct Configuration
 	unsigned message_delay_time;
 	unsigned lyrics_db;
 	unsigned lines_scrolled;
+	unsigned incremental_search_delay;
 	unsigned search_engine_default_search_mode;
 
 	boost::regex::flag_type regex_type;
@@ -18,13 +18,17 @@
  *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
  ***************************************************************************/
 
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 #include <boost/format.hpp>
 #include <boost/functional/hash.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/utility/string_ref.hpp>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "curses/window.h"
 #include "song.h"
@@ -35,32 +39,252 @@ namespace {
 
 // Prepend '0' if the tag is a single digit number so that we get "expected"
 // sort order with regular string comparison.
+bool needs_numeric_padding(boost::string_ref s)
+{
+	return (s.length() == 1 && s[0] != '0')
+		|| (s.length() > 3 && s[1] == '/');
+}
+
 void format_numeric_tag(std::string &s)
 {
-	if ((s.length() == 1 && s[0] != '0')
-	    || (s.length() > 3 && s[1] == '/'))
+	if (needs_numeric_padding(s))
 		s = "0"+s;
 }
 
-size_t calc_hash(const char *s, size_t seed = 0)
+struct UriHash
+{
+	size_t operator()(boost::string_ref s) const
+	{
+		size_t seed = 0;
+		for (char c : s)
+			boost::hash_combine(seed, c);
+		return seed;
+	}
+};
+
+}
+
+namespace MPD {
+
+struct SongRecord
 {
-	for (; *s != '\0'; ++s)
-		boost::hash_combine(seed, *s);
-	return seed;
+	~SongRecord();
+
+	std::string uri;
+	size_t hash;
+	unsigned duration;
+	time_t mtime;
+	// Values are interned. Tags of the same type are adjacent and in the
+	// order they were received in.
+	std::vector<std::pair<mpd_tag_type, const char *>> tags;
+	// Interned values of tags with diacritics stripped (if enabled).
+	std::vector<const char *> stripped;
+};
+
+}
+
+namespace {
+
+// Central table of songs. Songs with the same URI share a single record as
+// long as their metadata is the same and tag values are stored only once (as
+// long as any record refers to them).
+struct SongTable
+{
+	std::shared_ptr<const MPD::SongRecord> get(mpd_song *s);
+	void release(const MPD::SongRecord &record);
+
+private:
+	struct Interned
+	{
+		Interned() : references(0), stripped(nullptr) { }
+
+		// Number of references from records.
+		size_t references;
+		// Value with diacritics stripped, it holds a reference to it if it's
+		// a different string.
+		const char *stripped;
+	};
+	typedef std::unordered_map<std::string, Interned> Strings;
+
+	const char *intern(const std::string &value);
+	Strings::iterator findInterned(const char *value);
+	const char *stripped(Strings::iterator value);
+	void release(Strings::iterator value);
+
+	// Songs are copied to and destroyed in worker threads (e.g. lyrics).
+	std::mutex m_mutex;
+	Strings m_strings;
+	std::unordered_map<
+		boost::string_ref,
+		std::weak_ptr<const MPD::SongRecord>,
+		UriHash> m_records;
+	std::vector<std::pair<mpd_tag_type, const char *>> m_tags;
+};
+
+SongTable &songTable()
+{
+	// Never destroyed as songs in global objects may outlive it otherwise.
+	static SongTable *table = new SongTable;
+	return *table;
+}
+
+std::shared_ptr<const MPD::SongRecord> SongTable::get(mpd_song *s)
+{
+	const char *uri = mpd_song_get_uri(s);
+	unsigned duration = mpd_song_get_duration(s);
+	time_t mtime = mpd_song_get_last_modified(s);
+
+	// If it turns out to be the last reference, the record needs to be
+	// destroyed after the mutex is unlocked.
+	std::shared_ptr<const MPD::SongRecord> old_record;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_tags.clear();
+	for (unsigned type = 0; type < MPD_TAG_COUNT; ++type)
+	{
+		auto tag_type = static_cast<mpd_tag_type>(type);
+		const char *value;
+		for (unsigned idx = 0; (value = mpd_song_get_tag(s, tag_type, idx)) != nullptr; ++idx)
+		{
+			// Intern numeric tags that need padding with it so that the padded
+			// value can be referenced by getRef (it directly precedes the
+			// original one).
+			if ((tag_type == MPD_TAG_TRACK || tag_type == MPD_TAG_DISC)
+			    && needs_numeric_padding(value))
+				m_tags.emplace_back(tag_type, intern("0" + std::string(value)) + 1);
+			else
+				m_tags.emplace_back(tag_type, intern(value));
+		}
+	}
+
+	auto it = m_records.find(uri);
+	if (it != m_records.end())
+	{
+		old_record = it->second.lock();
+		// Interned values can be compared by address.
+		if (old_record
+		    && old_record->duration == duration
+		    && old_record->mtime == mtime
+		    && old_record->tags == m_tags)
+			return old_record;
+		// Metadata changed (or the record is being destroyed), the new
+		// record replaces the old one for subsequent lookups.
+		m_records.erase(it);
+	}
+
+	auto record = std::make_shared<MPD::SongRecord>();
+	record->uri = uri;
+	record->hash = UriHash()(record->uri);
+	record->duration = duration;
+	record->mtime = mtime;
+	record->tags = m_tags;
+	for (const auto &tag : record->tags)
+	{
+		auto value = findInterned(tag.second);
+		++value->second.references;
+		if (MPD::Song::StripDiacritics != nullptr)
+		{
+			// Padded numeric values don't point to the beginning of the
+			// interned string, but there is nothing to strip from them anyway.
+			record->stripped.push_back(
+				value->first.c_str() == tag.second ? stripped(value) : tag.second);
+		}
+	}
+	m_records.emplace(record->uri, record);
+	return record;
+}
+
+void SongTable::release(const MPD::SongRecord &record)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_records.find(record.uri);
+	// The entry might have been already replaced by a newer record.
+	if (it != m_records.end() && it->second.expired())
+		m_records.erase(it);
+	for (const auto &tag : record.tags)
+		release(findInterned(tag.second));
+}
+
+const char *SongTable::intern(const std::string &value)
+{
+	return m_strings.emplace(value, Interned()).first->first.c_str();
+}
+
+const char *SongTable::stripped(Strings::iterator value)
+{
+	auto &interned = value->second;
+	if (interned.stripped == nullptr)
+	{
+		auto stripped = MPD::Song::StripDiacritics(value->first);
+		if (stripped == value->first)
+			interned.stripped = value->first.c_str();
+		else
+		{
+			auto it = m_strings.emplace(std::move(stripped), Interned()).first;
+			++it->second.references;
+			interned.stripped = it->first.c_str();
+		}
+	}
+	return interned.stripped;
+}
+
+void SongTable::release(Strings::iterator value)
+{
+	// Values no other record refers to are no longer needed.
+	if (--value->second.references > 0)
+		return;
+	const char *stripped = value->second.stripped;
+	bool release_stripped = stripped != nullptr && stripped != value->first.c_str();
+	m_strings.erase(value);
+	if (release_stripped)
+		release(m_strings.find(stripped));
+}
+
+SongTable::Strings::iterator SongTable::findInterned(const char *value)
+{
+	// Padded numeric values point one character past the beginning of the
+	// interned string, in which case a different (or no) string is found.
+	auto it = m_strings.find(value);
+	if (it != m_strings.end() && it->first.c_str() == value)
+		return it;
+	it = m_strings.find(value - 1);
+	assert(it != m_strings.end() && it->first.c_str() == value - 1);
+	return it;
 }
 
 }
 
 namespace MPD {
 
+SongRecord::~SongRecord()
+{
+	songTable().release(*this);
+}
+
 std::string Song::TagsSeparator = " | ";
 
 bool Song::ShowDuplicateTags = true;
 
+std::string (*Song::StripDiacritics)(boost::string_ref s) = nullptr;
+
+const char *Song::getTag(mpd_tag_type type, unsigned idx) const
+{
+	assert(m_record);
+	const auto &tags = m_record->tags;
+	auto first = std::lower_bound(
+		tags.begin(), tags.end(), type,
+		[](const std::pair<mpd_tag_type, const char *> &tag, mpd_tag_type t) {
+			return tag.first < t;
+		});
+	if (idx < size_t(tags.end() - first) && first[idx].first == type)
+		return first[idx].second;
+	else
+		return nullptr;
+}
+
 std::string Song::get(mpd_tag_type type, unsigned idx) const
 {
 	std::string result;
-	const char *tag = mpd_song_get_tag(m_song.get(), type, idx);
+	const char *tag = getTag(type, idx);
 	if (tag)
 		result = tag;
 	return result;
@@ -69,29 +293,146 @@ std::string Song::get(mpd_tag_type type, unsigned idx) const
 Song::Song(mpd_song *s)
 {
 	assert(s);
-	m_song = std::shared_ptr<mpd_song>(s, mpd_song_free);
-	m_hash = calc_hash(mpd_song_get_uri(s));
+	m_record = songTable().get(s);
+	m_pos = mpd_song_get_pos(s);
+	m_id = mpd_song_get_id(s);
+	m_prio = mpd_song_get_prio(s);
+	m_hash = m_record->hash;
+	mpd_song_free(s);
+}
+
+const char *Song::c_uri() const
+{
+	return m_record ? m_record->uri.c_str() : "";
+}
+
+boost::string_ref Song::getRef(GetFunction f, unsigned idx, std::string &buffer) const
+{
+	assert(m_record);
+	auto tag = [this, idx](mpd_tag_type type) {
+		const char *value = getTag(type, idx);
+		return value ? boost::string_ref(value) : boost::string_ref();
+	};
+	auto numeric_tag = [this, idx](mpd_tag_type type) {
+		const char *value = getTag(type, idx);
+		if (value == nullptr)
+			return boost::string_ref();
+		boost::string_ref result(value);
+		// padded value is interned right before the original one
+		if (needs_numeric_padding(result))
+			result = boost::string_ref(value-1, result.size()+1);
+		return result;
+	};
+
+	if (f == &Song::getArtist)
+		return tag(MPD_TAG_ARTIST);
+	else if (f == &Song::getTitle)
+		return tag(MPD_TAG_TITLE);
+	else if (f == &Song::getAlbum)
+		return tag(MPD_TAG_ALBUM);
+	else if (f == &Song::getAlbumArtist)
+		return tag(MPD_TAG_ALBUM_ARTIST);
+	else if (f == &Song::getDate)
+		return tag(MPD_TAG_DATE);
+	else if (f == &Song::getGenre)
+		return tag(MPD_TAG_GENRE);
+	else if (f == &Song::getComposer)
+		return tag(MPD_TAG_COMPOSER);
+	else if (f == &Song::getPerformer)
+		return tag(MPD_TAG_PERFORMER);
+	else if (f == &Song::getComment)
+		return tag(MPD_TAG_COMMENT);
+	else if (f == &Song::getTrack)
+		return numeric_tag(MPD_TAG_TRACK);
+	else if (f == &Song::getDisc)
+		return numeric_tag(MPD_TAG_DISC);
+	else if (f == &Song::getTrackNumber)
+	{
+		auto track = numeric_tag(MPD_TAG_TRACK);
+		size_t slash = track.find('/');
+		if (slash != boost::string_ref::npos)
+			track = track.substr(0, slash);
+		return track;
+	}
+	else if (f == &Song::getURI)
+		return idx > 0 ? boost::string_ref() : boost::string_ref(m_record->uri);
+	else if (f == &Song::getName)
+	{
+		const char *name = getTag(MPD_TAG_NAME, idx);
+		if (name != nullptr)
+			return name;
+		else if (idx > 0)
+			return boost::string_ref();
+		boost::string_ref uri(m_record->uri);
+		size_t slash = uri.rfind('/');
+		return slash != boost::string_ref::npos ? uri.substr(slash+1) : uri;
+	}
+	else if (f == &Song::getDirectory)
+	{
+		if (idx > 0 || isStream())
+			return boost::string_ref();
+		boost::string_ref uri(m_record->uri);
+		size_t slash = uri.rfind('/');
+		return slash != boost::string_ref::npos ? uri.substr(0, slash) : "/";
+	}
+	// the value needs to be computed
+	buffer = (this->*f)(idx);
+	return buffer;
+}
+
+boost::string_ref Song::getStrippedRef(GetFunction f, unsigned idx, std::string &buffer) const
+{
+	auto value = getRef(f, idx, buffer);
+	if (StripDiacritics == nullptr || value.empty())
+		return value;
+	// There is nothing to strip from ASCII strings.
+	if (std::all_of(value.begin(), value.end(), [](char c) { return !(c & 0x80); }))
+		return value;
+	// Look for the stored value the result refers to (as a whole, not just
+	// its prefix). Tags are few, so a linear search is enough.
+	const auto &tags = m_record->tags;
+	const auto &stripped = m_record->stripped;
+	if (!stripped.empty() && value.data()[value.size()] == '\0')
+	{
+		for (size_t i = 0; i < tags.size(); ++i)
+			if (tags[i].second == value.data())
+				return stripped[i];
+	}
+	buffer = StripDiacritics(value);
+	return buffer;
+}
+
+boost::string_ref Song::getTagsRef(GetFunction f, std::string &buffer) const
+{
+	auto value = getRef(f, 0, buffer);
+	if (value.empty())
+		return value;
+	// values need to be joined only if there is more than one of them
+	std::string next_buffer;
+	if (getRef(f, 1, next_buffer).empty())
+		return value;
+	buffer = getTags(f);
+	return buffer;
 }
 
 std::string Song::getURI(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	if (idx > 0)
 		return "";
 	else
-		return mpd_song_get_uri(m_song.get());
+		return m_record->uri;
 }
 
 std::string Song::getName(unsigned idx) const
 {
-	assert(m_song);
-	mpd_song *s = m_song.get();
-	const char *res = mpd_song_get_tag(s, MPD_TAG_NAME, idx);
+	assert(m_record);
+	const char *res = getTag(MPD_TAG_NAME, idx);
 	if (res)
 		return res;
 	else if (idx > 0)
 		return "";
-	const char *uri = mpd_song_get_uri(s);
+	const char *uri = m_record->uri.c_str();
 	const char *name = strrchr(uri, '/');
 	if (name)
 		return name+1;
@@ -101,10 +442,10 @@ std::string Song::getName(unsigned idx) const
 
 std::string Song::getDirectory(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	if (idx > 0 || isStream())
 		return "";
-	const char *uri = mpd_song_get_uri(m_song.get());
+	const char *uri = m_record->uri.c_str();
 	const char *name = strrchr(uri, '/');
 	if (name)
 		return std::string(uri, name-uri);
@@ -114,31 +455,31 @@ std::string Song::getDirectory(unsigned idx) const
 
 std::string Song::getArtist(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_ARTIST, idx);
 }
 
 std::string Song::getTitle(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_TITLE, idx);
 }
 
 std::string Song::getAlbum(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_ALBUM, idx);
 }
 
 std::string Song::getAlbumArtist(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_ALBUM_ARTIST, idx);
 }
 
 std::string Song::getTrack(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	std::string track = get(MPD_TAG_TRACK, idx);
 	format_numeric_tag(track);
 	return track;
@@ -146,7 +487,7 @@ std::string Song::getTrack(unsigned idx) const
 
 std::string Song::getTrackNumber(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	std::string track = getTrack(idx);
 	size_t slash = track.find('/');
 	if (slash != std::string::npos)
@@ -156,31 +497,31 @@ std::string Song::getTrackNumber(unsigned idx) const
 
 std::string Song::getDate(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_DATE, idx);
 }
 
 std::string Song::getGenre(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_GENRE, idx);
 }
 
 std::string Song::getComposer(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_COMPOSER, idx);
 }
 
 std::string Song::getPerformer(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_PERFORMER, idx);
 }
 
 std::string Song::getDisc(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	std::string disc = get(MPD_TAG_DISC, idx);
 	format_numeric_tag(disc);
 	return disc;
@@ -188,13 +529,13 @@ std::string Song::getDisc(unsigned idx) const
 
 std::string Song::getComment(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	return get(MPD_TAG_COMMENT, idx);
 }
 
 std::string Song::getLength(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	if (idx > 0)
 		return "";
 	unsigned len = getDuration();
@@ -206,7 +547,7 @@ std::string Song::getLength(unsigned idx) const
 
 std::string Song::getPriority(unsigned idx) const
 {
-	assert(m_song);
+	assert(m_record);
 	if (idx > 0)
 		return "";
 	return boost::lexical_cast<std::string>(getPrio());
@@ -214,7 +555,7 @@ std::string Song::getPriority(unsigned idx) const
 
 std::string MPD::Song::getTags(GetFunction f) const
 {
-	assert(m_song);
+	assert(m_record);
 	unsigned idx = 0;
 	std::string result;
 	if (ShowDuplicateTags)
@@ -255,50 +596,50 @@ std::string MPD::Song::getTags(GetFunction f) const
 
 unsigned Song::getDuration() const
 {
-	assert(m_song);
-	return mpd_song_get_duration(m_song.get());
+	assert(m_record);
+	return m_record->duration;
 }
 
 unsigned Song::getPosition() const
 {
-	assert(m_song);
-	return mpd_song_get_pos(m_song.get());
+	assert(m_record);
+	return m_pos;
 }
 
 unsigned Song::getID() const
 {
-	assert(m_song);
-	return mpd_song_get_id(m_song.get());
+	assert(m_record);
+	return m_id;
 }
 
 unsigned Song::getPrio() const
 {
-	assert(m_song);
-	return mpd_song_get_prio(m_song.get());
+	assert(m_record);
+	return m_prio;
 }
 
 time_t Song::getMTime() const
 {
-	assert(m_song);
-	return mpd_song_get_last_modified(m_song.get());
+	assert(m_record);
+	return m_record->mtime;
 }
 
 bool Song::isFromDatabase() const
 {
-	assert(m_song);
-	const char *uri = mpd_song_get_uri(m_song.get());
+	assert(m_record);
+	const char *uri = m_record->uri.c_str();
 	return uri[0] != '/' || !strrchr(uri, '/');
 }
 
 bool Song::isStream() const
 {
-	assert(m_song);
-	return !strncmp(mpd_song_get_uri(m_song.get()), "http://", 7);
+	assert(m_record);
+	return !strncmp(m_record->uri.c_str(), "http://", 7);
 }
 
 bool Song::empty() const
 {
-	return m_song.get() == 0;
+	return m_record.get() == 0;
 }
 
 std::string Song::ShowTime(unsigned length)
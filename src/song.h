@@ -26,11 +26,14 @@
 #include <memory>
 #include <string>
 #include <vector>
+#include <boost/utility/string_ref.hpp>
 
 #include <mpd/client.h>
 
 namespace MPD {
 
+struct SongRecord;
+
 struct Song
 {
 	struct Hash {
@@ -39,16 +42,23 @@ struct Song
 
 	typedef std::string (Song::*GetFunction)(unsigned) const;
 	
-	Song() : m_hash(0) { }
+	Song() : m_pos(0), m_id(0), m_prio(0), m_hash(0) { }
 	virtual ~Song() { }
 	
 	Song(mpd_song *s);
 
-	Song(const Song &rhs) : m_song(rhs.m_song), m_hash(rhs.m_hash) { }
-	Song(Song &&rhs) : m_song(std::move(rhs.m_song)), m_hash(rhs.m_hash) { }
+	Song(const Song &rhs)
+	: m_record(rhs.m_record), m_pos(rhs.m_pos), m_id(rhs.m_id)
+	, m_prio(rhs.m_prio), m_hash(rhs.m_hash) { }
+	Song(Song &&rhs)
+	: m_record(std::move(rhs.m_record)), m_pos(rhs.m_pos), m_id(rhs.m_id)
+	, m_prio(rhs.m_prio), m_hash(rhs.m_hash) { }
 	Song &operator=(Song rhs)
 	{
-		m_song = std::move(rhs.m_song);
+		m_record = std::move(rhs.m_record);
+		m_pos = rhs.m_pos;
+		m_id = rhs.m_id;
+		m_prio = rhs.m_prio;
 		m_hash = rhs.m_hash;
 		return *this;
 	}
@@ -74,6 +84,16 @@ struct Song
 	virtual std::string getPriority(unsigned idx = 0) const;
 	
 	virtual std::string getTags(GetFunction f) const;
+
+	/// Non-allocating counterparts of get functions and getTags. Return
+	/// reference to the stored value if possible, otherwise the value is
+	/// computed into the buffer.
+	virtual boost::string_ref getRef(GetFunction f, unsigned idx, std::string &buffer) const;
+	boost::string_ref getTagsRef(GetFunction f, std::string &buffer) const;
+	/// Counterpart of getRef that returns the value with diacritics stripped.
+	/// Stored tag values are stripped once, when the song is received (if
+	/// StripDiacritics is set at that time), other ones into the buffer.
+	boost::string_ref getStrippedRef(GetFunction f, unsigned idx, std::string &buffer) const;
 	
 	virtual unsigned getDuration() const;
 	virtual unsigned getPosition() const;
@@ -90,14 +110,14 @@ struct Song
 	{
 		if (m_hash != rhs.m_hash)
 			return false;
-		return strcmp(c_uri(), rhs.c_uri()) == 0;
+		return m_record == rhs.m_record || strcmp(c_uri(), rhs.c_uri()) == 0;
 	}
 	bool operator!=(const Song &rhs) const
 	{
 		return !(operator==(rhs));
 	}
 
-	const char *c_uri() const { return m_song ? mpd_song_get_uri(m_song.get()) : ""; }
+	const char *c_uri() const;
 
 	static std::string ShowTime(unsigned length);
 
@@ -105,8 +125,19 @@ struct Song
 
 	static bool ShowDuplicateTags;
 
+	/// Function stripping diacritics from tag values. If set, stripped values
+	/// are stored along with the original ones.
+	static std::string (*StripDiacritics)(boost::string_ref s);
+
 private:
-	std::shared_ptr<mpd_song> m_song;
+	const char *getTag(mpd_tag_type type, unsigned idx) const;
+
+	// URI and tags are shared by all songs with the same URI, only
+	// attributes specific to the playlist entry are kept separately.
+	std::shared_ptr<const SongRecord> m_record;
+	unsigned m_pos;
+	unsigned m_id;
+	unsigned m_prio;
 	size_t m_hash;
 };
 
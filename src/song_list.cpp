@@ -55,9 +55,8 @@ ConstSongIterator SongMenu::endS() const
 std::vector<MPD::Song> SongMenu::getSelectedSongs()
 {
 	std::vector<MPD::Song> result;
-	for (auto it = begin(); it != end(); ++it)
-		if (it->isSelected())
-			result.push_back(it->value());
+	for (auto pos : selectedPositions())
+		result.push_back((*this)[pos].value());
 	if (result.empty() && !empty())
 		result.push_back(current()->value());
 	return result;
@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <chrono>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
 
@@ -28,6 +29,7 @@
 #include "format_impl.h"
 #include "global.h"
 #include "helpers.h"
+#include "library_snapshot.h"
 #include "macro_utilities.h"
 #include "screens/lyrics.h"
 #include "screens/media_library.h"
@@ -54,7 +56,11 @@ using Global::VolumeState;
 
 namespace {
 
-boost::posix_time::ptime past = boost::posix_time::from_time_t(0);
+// bitrate needs to be queried from MPD, so do it less often than
+// the elapsed time is updated
+const boost::posix_time::seconds bitrate_update_interval(5);
+boost::posix_time::ptime past_bitrate_update = boost::posix_time::from_time_t(0);
+unsigned displayed_elapsed_time;
 
 size_t playing_song_scroll_begin = 0;
 size_t first_line_scroll_begin = 0;
@@ -71,7 +77,9 @@ char m_single;
 
 int m_current_song_id;
 int m_current_song_pos;
-unsigned m_elapsed_time;
+// elapsed time is extrapolated from the last status we got from MPD
+unsigned m_elapsed_ms;
+std::chrono::steady_clock::time_point m_elapsed_time_anchor;
 unsigned m_kbps;
 MPD::PlayerState m_player_state;
 unsigned m_playlist_version;
@@ -79,6 +87,12 @@ unsigned m_playlist_length;
 unsigned m_total_time;
 int m_volume;
 
+void setElapsedTime(const MPD::Status &st)
+{
+	m_elapsed_ms = st.elapsedTimeMs();
+	m_elapsed_time_anchor = std::chrono::steady_clock::now();
+}
+
 void drawTitle(const MPD::Song &np)
 {
 	assert(!np.empty());
@@ -138,6 +152,7 @@ std::string playerStateToString(MPD::PlayerState ps)
 
 void initialize_status()
 {
+	restrictTagTypes();
 	// get full info about new connection
 	Status::update(-1);
 
@@ -231,12 +246,16 @@ void Status::trace(bool update_timer, bool update_window_timeout)
 			initialize_status();
 
 		if (m_player_state == MPD::psPlay
-		&&  Global::Timer - past > boost::posix_time::seconds(1))
+		&&  Status::State::elapsedTime() != displayed_elapsed_time)
 		{
-			// update elapsed time/bitrate of the current song
-			Status::Changes::elapsedTime(true);
+			// elapsed time is extrapolated locally, MPD is queried only
+			// for bitrate (if it's displayed) as it changes for VBR files.
+			bool update_bitrate = Config.display_bitrate
+				&& Timer - past_bitrate_update > bitrate_update_interval;
+			if (update_bitrate)
+				past_bitrate_update = Timer;
+			Status::Changes::elapsedTime(update_bitrate);
 			wFooter->refresh();
-			past = Timer;
 		}
 
 		applyToVisibleWindows(&BaseScreen::update);
@@ -260,7 +279,7 @@ void Status::update(int event)
 {
 	auto st = Mpd.getStatus();
 	m_current_song_pos = st.currentSongPosition();
-	m_elapsed_time = st.elapsedTime();
+	setElapsedTime(st);
 	m_kbps = st.kbps();
 	m_player_state = st.playerState();
 	m_playlist_length = st.playlistLength();
@@ -354,12 +373,15 @@ void Status::clear()
 	m_db_updating = 0;
 	m_current_song_id = -1;
 	m_current_song_pos = -1;
+	m_elapsed_ms = 0;
 	m_kbps = 0;
 	m_player_state = MPD::psUnknown;
 	m_playlist_length = 0;
 	m_playlist_version = 0;
 	m_total_time = 0;
 	m_volume = -1;
+	// database might have changed while we were disconnected
+	Library.invalidate();
 }
 
 /*************************************************************************/
@@ -406,7 +428,14 @@ unsigned Status::State::playlistLength()
 
 unsigned Status::State::elapsedTime()
 {
-	return m_elapsed_time;
+	auto elapsed_ms = m_elapsed_ms;
+	if (m_player_state == MPD::psPlay)
+		elapsed_ms += std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now() - m_elapsed_time_anchor).count();
+	unsigned elapsed_time = elapsed_ms / 1000;
+	if (m_total_time)
+		elapsed_time = std::min(elapsed_time, m_total_time);
+	return elapsed_time;
 }
 
 MPD::PlayerState Status::State::player()
@@ -428,6 +457,7 @@ int Status::State::volume()
 
 void Status::Changes::playlist(unsigned previous_version)
 {
+	bool now_playing_replaced = false;
 	{
 		ScopedUnfilteredMenu<MPD::Song> sunfilter(ReapplyFilter::Yes, myPlaylist->main());
 
@@ -451,6 +481,8 @@ void Status::Changes::playlist(unsigned previous_version)
 				MPD::Song &old_s = myPlaylist->main()[pos].value();
 				myPlaylist->unregisterSong(old_s);
 				old_s = std::move(*s);
+				if (int(pos) == Status::State::currentSongPosition())
+					now_playing_replaced = true;
 			}
 			else // otherwise just add it to playlist
 				myPlaylist->main().addItem(std::move(*s));
@@ -460,6 +492,15 @@ void Status::Changes::playlist(unsigned previous_version)
 	myPlaylist->reloadTotalLength();
 	myPlaylist->reloadRemaining();
 
+	// Tags of streams change without changing id of the song, so the title
+	// needs to be updated when the song that's playing is replaced.
+	if (now_playing_replaced && m_player_state != MPD::psStop)
+	{
+		auto np = myPlaylist->nowPlayingSong();
+		if (!np.empty())
+			drawTitle(np);
+	}
+
 	// When we're in multi-column screens, it might happen that songs visible on
 	// the screen are added, but they will not be immediately marked as such
 	// because the window that contains them is not the active one at the moment,
@@ -476,12 +517,14 @@ void Status::Changes::storedPlaylists()
 {
 	myPlaylistEditor->requestPlaylistsUpdate();
 	myPlaylistEditor->requestContentUpdate();
+	myPlaylistEditor->clearContentCache();
 	if (!myBrowser->isLocal() && myBrowser->inRootDirectory())
 		myBrowser->requestUpdate();
 }
 
 void Status::Changes::database()
 {
+	Library.invalidate();
 	myBrowser->requestUpdate();
 #	ifdef HAVE_TAGLIB_H
 	myTagEditor->Dirs->clear();
@@ -608,7 +651,7 @@ void Status::Changes::songID(int song_id)
 	elapsedTime(false);
 }
 
-void Status::Changes::elapsedTime(bool update_elapsed)
+void Status::Changes::elapsedTime(bool update_status)
 {
 	auto np = myPlaylist->nowPlayingSong();
 	if (m_player_state == MPD::psStop || np.empty())
@@ -622,17 +665,19 @@ void Status::Changes::elapsedTime(bool update_elapsed)
 		return;
 	}
 
-	if (update_elapsed)
+	if (update_status)
 	{
 		auto st = Mpd.getStatus();
-		m_elapsed_time = st.elapsedTime();
+		setElapsedTime(st);
 		m_kbps = st.kbps();
 	}
 
+	unsigned elapsed_time = State::elapsedTime();
+	displayed_elapsed_time = elapsed_time;
+
 	std::string ps = playerStateToString(m_player_state);
 	std::string tracklength;
 
-	drawTitle(np);
 	switch (Config.design)
 	{
 		case Design::Classic:
@@ -650,15 +695,15 @@ void Status::Changes::elapsedTime(bool update_elapsed)
 					if (Config.display_remaining_time)
 					{
 						tracklength += "-";
-						tracklength += MPD::Song::ShowTime(m_total_time-m_elapsed_time);
+						tracklength += MPD::Song::ShowTime(m_total_time-elapsed_time);
 					}
 					else
-						tracklength += MPD::Song::ShowTime(m_elapsed_time);
+						tracklength += MPD::Song::ShowTime(elapsed_time);
 					tracklength += "/";
 					tracklength += MPD::Song::ShowTime(m_total_time);
 				}
 				else
-					tracklength += MPD::Song::ShowTime(m_elapsed_time);
+					tracklength += MPD::Song::ShowTime(elapsed_time);
 				tracklength += "]";
 				NC::WBuffer np_song;
 				Format::print(Config.song_status_wformat, np_song, &np);
@@ -681,10 +726,10 @@ void Status::Changes::elapsedTime(bool update_elapsed)
 			if (Config.display_remaining_time)
 			{
 				tracklength = "-";
-				tracklength += MPD::Song::ShowTime(m_total_time-m_elapsed_time);
+				tracklength += MPD::Song::ShowTime(m_total_time-elapsed_time);
 			}
 			else
-				tracklength = MPD::Song::ShowTime(m_elapsed_time);
+				tracklength = MPD::Song::ShowTime(elapsed_time);
 			if (m_total_time)
 			{
 				tracklength += "/";
@@ -742,7 +787,7 @@ void Status::Changes::elapsedTime(bool update_elapsed)
 			flags();
 	}
 	if (Progressbar::isUnlocked())
-		Progressbar::draw(m_elapsed_time, m_total_time);
+		Progressbar::draw(elapsed_time, m_total_time);
 }
 
 void Status::Changes::flags()
@@ -61,7 +61,7 @@ void storedPlaylists();
 void database();
 void playerState();
 void songID(int song_id);
-void elapsedTime(bool update_elapsed);
+void elapsedTime(bool update_status);
 void flags();
 void mixer();
 void outputs();
@@ -192,6 +192,11 @@ void Statusbar::Helpers::mpd()
 	Status::update(Mpd.noidle());
 }
 
+void Statusbar::Helpers::mpdAsync()
+{
+	MpdAsync.process();
+}
+
 bool Statusbar::Helpers::mainHook(const char *)
 {
 	Status::trace();
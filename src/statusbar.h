@@ -66,6 +66,9 @@ namespace Helpers {
 /// called when statusbar window detects incoming idle notification
 void mpd();
 
+/// called when data arrives on the asynchronous connection
+void mpdAsync();
+
 /// called each time user types another character while inside Window::getString
 bool mainHook(const char *);
 
@@ -28,8 +28,14 @@
 
 void windowTitle(const std::string &status)
 {
-	if (Config.set_window_title)
+	// player state changes (e.g. seeking) redraw the title,
+	// so write it out only if it's actually different.
+	static std::string current_status;
+	if (Config.set_window_title && status != current_status)
+	{
 		std::cout << "\033]0;" << status << "\7" << std::flush;
+		current_status = status;
+	}
 }
 
 void drawHeader()
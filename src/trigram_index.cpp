@@ -0,0 +1,194 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <algorithm>
+#include <iterator>
+
+#include "trigram_index.h"
+
+namespace {
+
+const size_t TrigramsNumber = 1 << 21;
+
+// Calls f with trigrams of ASCII characters in s (lower cased).
+template <typename FunctionT>
+void forEachTrigram(boost::string_ref s, FunctionT &&f)
+{
+	uint32_t trigram = 0;
+	size_t ascii = 0;
+	for (char c : s)
+	{
+		if (c & 0x80)
+		{
+			ascii = 0;
+			continue;
+		}
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		trigram = ((trigram << 7) | c) & (TrigramsNumber - 1);
+		if (++ascii >= 3)
+			f(trigram);
+	}
+}
+
+}
+
+TrigramIndex::TrigramIndex()
+: m_strip_diacritics(false), m_songs(0), m_built(false)
+{ }
+
+void TrigramIndex::build(const std::vector<MPD::Song> &songs,
+                         const TagList &tags,
+                         bool strip_diacritics)
+{
+	clear();
+
+	// Gather distinct trigrams of each song first so that the postings can be
+	// laid out in one go.
+	std::vector<uint32_t> song_trigrams, song_offsets;
+	song_offsets.reserve(songs.size() + 1);
+	std::vector<uint32_t> counts(TrigramsNumber);
+	std::string buffer;
+	for (const auto &s : songs)
+	{
+		size_t first = song_trigrams.size();
+		song_offsets.push_back(first);
+		for (const auto &get : tags)
+		{
+			for (unsigned idx = 0;; ++idx)
+			{
+				auto value = strip_diacritics
+					? s.getStrippedRef(get, idx, buffer)
+					: s.getRef(get, idx, buffer);
+				if (value.empty())
+					break;
+				forEachTrigram(value, [&](uint32_t trigram) {
+					song_trigrams.push_back(trigram);
+				});
+			}
+		}
+		std::sort(song_trigrams.begin() + first, song_trigrams.end());
+		song_trigrams.erase(
+			std::unique(song_trigrams.begin() + first, song_trigrams.end()),
+			song_trigrams.end());
+		for (size_t i = first; i < song_trigrams.size(); ++i)
+			++counts[song_trigrams[i]];
+	}
+	song_offsets.push_back(song_trigrams.size());
+
+	// Positions of postings of each trigram are stored in counts from now on.
+	uint32_t position = 0;
+	for (uint32_t trigram = 0; trigram < TrigramsNumber; ++trigram)
+	{
+		if (counts[trigram] == 0)
+			continue;
+		m_trigrams.push_back(trigram);
+		m_offsets.push_back(position);
+		uint32_t count = counts[trigram];
+		counts[trigram] = position;
+		position += count;
+	}
+	m_offsets.push_back(position);
+	m_trigrams.shrink_to_fit();
+	m_offsets.shrink_to_fit();
+
+	m_postings.resize(position);
+	for (uint32_t song = 0; song < songs.size(); ++song)
+		for (size_t i = song_offsets[song]; i < song_offsets[song+1]; ++i)
+			m_postings[counts[song_trigrams[i]]++] = song;
+
+	m_tags = tags;
+	m_strip_diacritics = strip_diacritics;
+	m_songs = songs.size();
+	m_built = true;
+}
+
+void TrigramIndex::clear()
+{
+	m_trigrams.clear();
+	m_trigrams.shrink_to_fit();
+	m_offsets.clear();
+	m_offsets.shrink_to_fit();
+	m_postings.clear();
+	m_postings.shrink_to_fit();
+	m_tags.clear();
+	m_songs = 0;
+	m_built = false;
+}
+
+bool TrigramIndex::builtWith(const TagList &tags, bool strip_diacritics) const
+{
+	return m_built
+		&& m_tags == tags
+		&& m_strip_diacritics == strip_diacritics;
+}
+
+bool TrigramIndex::candidates(const std::vector<std::string> &literals,
+                              std::vector<uint32_t> &result) const
+{
+	std::vector<uint32_t> trigrams;
+	for (const auto &literal : literals)
+		forEachTrigram(literal, [&](uint32_t trigram) {
+			trigrams.push_back(trigram);
+		});
+	if (trigrams.empty())
+		return false;
+	std::sort(trigrams.begin(), trigrams.end());
+	trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+	typedef std::pair<const uint32_t *, const uint32_t *> Postings;
+	std::vector<Postings> postings;
+	for (auto trigram : trigrams)
+	{
+		auto it = std::lower_bound(m_trigrams.begin(), m_trigrams.end(), trigram);
+		if (it == m_trigrams.end() || *it != trigram)
+		{
+			result.clear();
+			return true;
+		}
+		size_t i = it - m_trigrams.begin();
+		postings.emplace_back(m_postings.data() + m_offsets[i],
+		                      m_postings.data() + m_offsets[i+1]);
+	}
+	// Intersecting from the shortest list keeps intermediate results small.
+	std::sort(postings.begin(), postings.end(),
+	          [](const Postings &a, const Postings &b) {
+		          return a.second - a.first < b.second - b.first;
+	          });
+	result.assign(postings[0].first, postings[0].second);
+	std::vector<uint32_t> next;
+	for (size_t i = 1; i < postings.size() && !result.empty(); ++i)
+	{
+		next.clear();
+		std::set_intersection(result.begin(), result.end(),
+		                      postings[i].first, postings[i].second,
+		                      std::back_inserter(next));
+		result.swap(next);
+	}
+	return true;
+}
+
+size_t TrigramIndex::memoryUsage() const
+{
+	return sizeof(*this)
+		+ (m_trigrams.capacity() + m_offsets.capacity() + m_postings.capacity())
+		* sizeof(uint32_t)
+		+ m_tags.capacity() * sizeof(MPD::Song::GetFunction);
+}
@@ -0,0 +1,70 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef NCMPCPP_TRIGRAM_INDEX_H
+#define NCMPCPP_TRIGRAM_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "song.h"
+
+/// Inverted index mapping trigrams of tag values to songs containing them. It
+/// answers which songs may contain given substrings, so that only these need
+/// to be checked against the actual constraints. Matching is case insensitive
+/// and only trigrams made of ASCII characters are indexed. Values may be
+/// indexed with diacritics stripped, then they can be searched for with
+/// diacritics ignored.
+struct TrigramIndex
+{
+	typedef std::vector<MPD::Song::GetFunction> TagList;
+
+	TrigramIndex();
+
+	void build(const std::vector<MPD::Song> &songs,
+	           const TagList &tags,
+	           bool strip_diacritics);
+	void clear();
+
+	/// @return true if the index was built with given parameters
+	bool builtWith(const TagList &tags, bool strip_diacritics) const;
+
+	/// Stores sorted positions of songs that may contain all the literals. If
+	/// no trigram could be extracted from them, nothing is narrowed down and
+	/// false is returned.
+	bool candidates(const std::vector<std::string> &literals,
+	                std::vector<uint32_t> &result) const;
+
+	size_t songs() const { return m_songs; }
+	/// @return approximate number of bytes used by the index
+	size_t memoryUsage() const;
+
+private:
+	std::vector<uint32_t> m_trigrams;
+	std::vector<uint32_t> m_offsets;
+	std::vector<uint32_t> m_postings;
+	TagList m_tags;
+	bool m_strip_diacritics;
+	size_t m_songs;
+	bool m_built;
+};
+
+#endif // NCMPCPP_TRIGRAM_INDEX_H
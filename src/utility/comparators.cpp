@@ -25,9 +25,9 @@
 
 namespace {
 
-bool hasTheWord(const std::string &s)
+bool hasTheWord(const char *s, size_t len)
 {
-	return s.length() >= 4
+	return len >= 4
 	&&     (s[0] == 't' || s[0] == 'T')
 	&&     (s[1] == 'h' || s[1] == 'H')
 	&&     (s[2] == 'e' || s[2] == 'E')
@@ -41,9 +41,9 @@ int LocaleStringComparison::compare(const char *a, size_t a_len, const char *b,
 	size_t ac_off = 0, bc_off = 0;
 	if (m_ignore_the)
 	{
-		if (hasTheWord(a))
+		if (hasTheWord(a, a_len))
 			ac_off += 4;
-		if (hasTheWord(b))
+		if (hasTheWord(b, b_len))
 			bc_off += 4;
 	}
 	return std::use_facet<std::collate<char>>(m_locale).compare(
@@ -51,6 +51,61 @@ int LocaleStringComparison::compare(const char *a, size_t a_len, const char *b,
 	);
 }
 
+std::string LocaleStringComparison::key(boost::string_ref s) const
+{
+	if (m_ignore_the && hasTheWord(s.data(), s.length()))
+		s.remove_prefix(4);
+	return std::use_facet<std::collate<char>>(m_locale).transform(
+		s.data(), s.data()+s.length()
+	);
+}
+
+auto LocaleBasedItemSorting::key(const MPD::Item &a) const -> Key
+{
+	std::string name;
+	time_t mtime = 0;
+	switch (m_sort_mode)
+	{
+		case SortMode::Type:
+			break;
+		case SortMode::Name:
+		case SortMode::CustomFormat:
+			switch (a.type())
+			{
+				case MPD::Item::Type::Directory:
+					name = m_cmp.key(a.directory().path());
+					break;
+				case MPD::Item::Type::Playlist:
+					name = m_cmp.key(a.playlist().path());
+					break;
+				case MPD::Item::Type::Song:
+					if (m_sort_mode == SortMode::Name)
+						name = m_cmp.key(a.song());
+					else
+						name = m_cmp.key(Format::stringify<char>(Config.browser_sort_format, &a.song()));
+					break;
+			}
+			break;
+		case SortMode::ModificationTime:
+			switch (a.type())
+			{
+				case MPD::Item::Type::Directory:
+					mtime = -a.directory().lastModified();
+					break;
+				case MPD::Item::Type::Playlist:
+					mtime = -a.playlist().lastModified();
+					break;
+				case MPD::Item::Type::Song:
+					mtime = -a.song().getMTime();
+					break;
+			}
+			break;
+		case SortMode::None:
+			throw std::logic_error("can't sort with None sorting mode");
+	}
+	return Key(a.type(), std::move(name), mtime);
+}
+
 bool LocaleBasedItemSorting::operator()(const MPD::Item &a, const MPD::Item &b) const
 {
 	bool result = false;
@@ -21,7 +21,13 @@
 #ifndef NCMPCPP_UTILITY_COMPARATORS_H
 #define NCMPCPP_UTILITY_COMPARATORS_H
 
+#include <algorithm>
+#include <exception>
 #include <string>
+#include <system_error>
+#include <thread>
+#include <tuple>
+#include <vector>
 #include "runnable_item.h"
 #include "mpdpp.h"
 #include "settings.h"
@@ -42,8 +48,15 @@ public:
 	int operator()(const std::string &a, const std::string &b) const {
 		return compare(a.c_str(), a.length(), b.c_str(), b.length());
 	}
+	int operator()(boost::string_ref a, boost::string_ref b) const {
+		return compare(a.data(), a.length(), b.data(), b.length());
+	}
 
 	int compare(const char *a, size_t a_len, const char *b, size_t b_len) const;
+
+	/// @return key of the string such that comparing keys of two strings
+	/// with operator< is equivalent to comparing the strings themselves
+	std::string key(boost::string_ref s) const;
 };
 
 class LocaleBasedSorting
@@ -62,7 +75,9 @@ public:
 	}
 
 	bool operator()(const MPD::Song &a, const MPD::Song &b) const {
-		return m_cmp(a.getName(), b.getName()) < 0;
+		std::string a_buffer, b_buffer;
+		return m_cmp(a.getRef(&MPD::Song::getName, 0, a_buffer),
+		             b.getRef(&MPD::Song::getName, 0, b_buffer)) < 0;
 	}
 	
 	template <typename A, typename B>
@@ -74,6 +89,31 @@ public:
 	bool operator()(const RunnableItem<ItemT, FunT> &a, const RunnableItem<ItemT, FunT> &b) const {
 		return m_cmp(a.item(), b.item()) < 0;
 	}
+
+	// Keys for sortByKey, ordered the same way as the objects.
+
+	std::string key(const std::string &s) const {
+		return m_cmp.key(s);
+	}
+
+	std::string key(const MPD::Playlist &a) const {
+		return m_cmp.key(a.path());
+	}
+
+	std::string key(const MPD::Song &a) const {
+		std::string buffer;
+		return m_cmp.key(a.getRef(&MPD::Song::getName, 0, buffer));
+	}
+
+	template <typename A, typename B>
+	std::string key(const std::pair<A, B> &a) const {
+		return key(a.first);
+	}
+
+	template <typename ItemT, typename FunT>
+	std::string key(const RunnableItem<ItemT, FunT> &a) const {
+		return key(a.item());
+	}
 };
 
 class LocaleBasedItemSorting
@@ -92,6 +132,101 @@ public:
 	{
 		return (*this)(a.value(), b.value());
 	}
+
+	/// Type of the item, collation key of its name and negated modification
+	/// time (so that the most recently modified items come first).
+	typedef std::tuple<MPD::Item::Type, std::string, time_t> Key;
+
+	Key key(const MPD::Item &a) const;
+
+	Key key(const NC::Menu<MPD::Item>::Item &a) const
+	{
+		return key(a.value());
+	}
 };
 
+/// Stably sorts the range by keys computed once per element with key_fun and
+/// compared with operator<. This is much faster than using a comparator that
+/// extracts tags or collates strings on every comparison. Big ranges are
+/// sorted in parallel, so key_fun needs to be thread safe.
+template <typename IteratorT, typename KeyFunT>
+void sortByKey(IteratorT first, IteratorT last, KeyFunT key_fun)
+{
+	typedef typename std::decay<decltype(key_fun(*first))>::type Key;
+	typedef std::pair<Key, size_t> Entry;
+	typedef typename std::iterator_traits<IteratorT>::value_type Value;
+
+	const size_t parallel_threshold = 10000;
+	const size_t max_threads = 8;
+
+	const size_t size = last - first;
+	if (size < 2)
+		return;
+
+	std::vector<Entry> keys(size);
+	auto less = [](const Entry &a, const Entry &b) {
+		return a.first < b.first;
+	};
+
+	size_t chunks = 1;
+	if (size >= parallel_threshold)
+		chunks = std::max(std::min<size_t>(std::thread::hardware_concurrency(), max_threads),
+		                  size_t(1));
+	std::vector<size_t> bounds;
+	for (size_t i = 0; i <= chunks; ++i)
+		bounds.push_back(size * i / chunks);
+
+	std::vector<std::exception_ptr> errors(chunks);
+	auto sort_chunk = [&](size_t chunk) {
+		try
+		{
+			for (size_t i = bounds[chunk]; i < bounds[chunk+1]; ++i)
+				keys[i] = Entry(key_fun(*(first + i)), i);
+			std::stable_sort(keys.begin() + bounds[chunk], keys.begin() + bounds[chunk+1], less);
+		}
+		catch (...)
+		{
+			errors[chunk] = std::current_exception();
+		}
+	};
+	std::vector<std::thread> threads;
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+	{
+		try
+		{
+			threads.emplace_back(sort_chunk, chunk);
+		}
+		catch (std::system_error &)
+		{
+			sort_chunk(chunk);
+		}
+	}
+	sort_chunk(0);
+	for (auto &thread : threads)
+		thread.join();
+	for (auto &error : errors)
+		if (error)
+			std::rethrow_exception(error);
+	for (size_t chunk = 1; chunk < chunks; ++chunk)
+		std::inplace_merge(keys.begin(),
+		                   keys.begin() + bounds[chunk],
+		                   keys.begin() + bounds[chunk+1],
+		                   less);
+
+	std::vector<Value> sorted;
+	sorted.reserve(size);
+	for (auto &entry : keys)
+		sorted.push_back(std::move(*(first + entry.second)));
+	std::move(sorted.begin(), sorted.end(), first);
+}
+
+/// Convenience wrapper for sorting with a comparator that provides keys.
+template <typename IteratorT, typename ComparatorT>
+void sortByKeyOf(IteratorT first, IteratorT last, const ComparatorT &cmp)
+{
+	sortByKey(first, last, [&cmp](const auto &value) {
+		return cmp.key(value);
+	});
+}
+
 #endif // NCMPCPP_UTILITY_COMPARATORS_H
@@ -0,0 +1,151 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#include <algorithm>
+
+#include "utility/fuzzy_match.h"
+
+namespace {
+
+const int ScoreMatch = 16;
+const int ScoreGapStart = -3;
+const int ScoreGapExtension = -1;
+const int BonusBoundary = 8;
+const int BonusCamelCase = 7;
+const int BonusConsecutive = 4;
+const int BonusFirstCharMultiplier = 2;
+
+char toLower(char c)
+{
+	return c >= 'A' && c <= 'Z' ? c + ('a' - 'A') : c;
+}
+
+bool isWordChar(char c)
+{
+	// Non-ASCII characters are assumed to be letters.
+	return (c & 0x80)
+		|| (c >= 'a' && c <= 'z')
+		|| (c >= 'A' && c <= 'Z')
+		|| (c >= '0' && c <= '9');
+}
+
+int bonusAt(boost::string_ref s, size_t pos)
+{
+	if (pos == 0 || !isWordChar(s[pos-1]))
+		return BonusBoundary;
+	else if (s[pos-1] >= 'a' && s[pos-1] <= 'z' && s[pos] >= 'A' && s[pos] <= 'Z')
+		return BonusCamelCase;
+	else
+		return 0;
+}
+
+}
+
+FuzzyPattern::FuzzyPattern(boost::string_ref pattern)
+{
+	for (size_t i = 0; i < pattern.size();)
+	{
+		size_t len = 1;
+		if (pattern[i] & 0x80)
+			while (i + len < pattern.size() && (pattern[i + len] & 0xC0) == 0x80)
+				++len;
+		std::string c = pattern.substr(i, len).to_string();
+		if (len == 1)
+			c[0] = toLower(c[0]);
+		if (c != " ")
+			m_chars.push_back(std::move(c));
+		i += len;
+	}
+}
+
+bool FuzzyPattern::match(boost::string_ref s, int &score) const
+{
+	if (m_chars.empty())
+	{
+		score = 0;
+		return true;
+	}
+
+	// Find where the leftmost occurrence of the pattern ends and then go
+	// backwards from there to find the shortest one ending at the same place.
+	size_t end = 0;
+	for (size_t i = 0; i < m_chars.size(); ++i)
+	{
+		end = findForward(s, end, i);
+		if (end == boost::string_ref::npos)
+			return false;
+		end += m_chars[i].size();
+	}
+	size_t start = end;
+	for (size_t i = m_chars.size(); i-- > 0;)
+		start = findBackward(s, start, i);
+
+	score = 0;
+	size_t pos = start, last_end = boost::string_ref::npos;
+	int chunk_bonus = 0;
+	for (size_t i = 0; i < m_chars.size(); ++i)
+	{
+		pos = findForward(s, pos, i);
+		int bonus = bonusAt(s, pos);
+		if (pos == last_end)
+		{
+			// Consecutive characters get at least the bonus of the first one.
+			bonus = std::max({bonus, chunk_bonus, BonusConsecutive});
+		}
+		else
+		{
+			if (last_end != boost::string_ref::npos)
+				score += ScoreGapStart + ScoreGapExtension * int(pos - last_end - 1);
+			chunk_bonus = bonus;
+		}
+		if (i == 0)
+			bonus *= BonusFirstCharMultiplier;
+		score += ScoreMatch + bonus;
+		last_end = pos + m_chars[i].size();
+		pos = last_end;
+	}
+	return true;
+}
+
+bool FuzzyPattern::matchAt(boost::string_ref s, size_t pos, size_t i) const
+{
+	const auto &c = m_chars[i];
+	if (c.size() == 1)
+		return toLower(s[pos]) == c[0];
+	else
+		return s.substr(pos, c.size()) == c;
+}
+
+size_t FuzzyPattern::findForward(boost::string_ref s, size_t pos, size_t i) const
+{
+	for (; pos < s.size(); ++pos)
+		if (matchAt(s, pos, i))
+			return pos;
+	return boost::string_ref::npos;
+}
+
+size_t FuzzyPattern::findBackward(boost::string_ref s, size_t end, size_t i) const
+{
+	// The pattern is known to occur before end, so it will be found.
+	size_t pos = end - m_chars[i].size();
+	while (!matchAt(s, pos, i))
+		--pos;
+	return pos;
+}
@@ -0,0 +1,54 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef NCMPCPP_UTILITY_FUZZY_MATCH_H
+#define NCMPCPP_UTILITY_FUZZY_MATCH_H
+
+#include <boost/utility/string_ref.hpp>
+#include <string>
+#include <vector>
+
+/// Pattern matching strings that contain its characters in the same order,
+/// but not necessarily next to each other. Matches are scored similarly to
+/// fzf, i.e. characters at the beginning of words and consecutive ones are
+/// preferred and gaps between them are penalized. ASCII characters are matched
+/// case insensitively.
+struct FuzzyPattern
+{
+	FuzzyPattern() { }
+	explicit FuzzyPattern(boost::string_ref pattern);
+
+	bool empty() const { return m_chars.empty(); }
+
+	/// @return true if s matches the pattern, score is set to the score of
+	/// the match then (higher is better)
+	bool match(boost::string_ref s, int &score) const;
+
+private:
+	bool matchAt(boost::string_ref s, size_t pos, size_t i) const;
+	size_t findForward(boost::string_ref s, size_t pos, size_t i) const;
+	size_t findBackward(boost::string_ref s, size_t end, size_t i) const;
+
+	// Characters of the pattern (lower cased if ASCII, UTF-8 sequences
+	// otherwise).
+	std::vector<std::string> m_chars;
+};
+
+#endif // NCMPCPP_UTILITY_FUZZY_MATCH_H
@@ -0,0 +1,87 @@
+/***************************************************************************
+ *   Copyright (C) 2008-2021 by Andrzej Rybczak                            *
+ *   andrzej@rybczak.net                                                   *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA.              *
+ ***************************************************************************/
+
+#ifndef NCMPCPP_UTILITY_LRU_CACHE_H
+#define NCMPCPP_UTILITY_LRU_CACHE_H
+
+#include <cassert>
+#include <list>
+#include <unordered_map>
+
+/// Holds at most given number of values, discarding the least recently used
+/// one when a new value doesn't fit.
+template <typename KeyT, typename ValueT, typename HashT = std::hash<KeyT>>
+struct LRUCache
+{
+	LRUCache(size_t capacity)
+	: m_capacity(capacity)
+	{
+		assert(m_capacity > 0);
+	}
+
+	/// @return pointer to the value associated with the key or nullptr if
+	/// there is none. Found value becomes the most recently used one.
+	const ValueT *get(const KeyT &key)
+	{
+		auto it = m_index.find(key);
+		if (it == m_index.end())
+			return nullptr;
+		m_items.splice(m_items.begin(), m_items, it->second);
+		return &it->second->second;
+	}
+
+	bool contains(const KeyT &key) const
+	{
+		return m_index.find(key) != m_index.end();
+	}
+
+	void put(KeyT key, ValueT value)
+	{
+		auto it = m_index.find(key);
+		if (it != m_index.end())
+		{
+			it->second->second = std::move(value);
+			m_items.splice(m_items.begin(), m_items, it->second);
+			return;
+		}
+		if (m_items.size() == m_capacity)
+		{
+			m_index.erase(m_items.back().first);
+			m_items.pop_back();
+		}
+		m_items.emplace_front(std::move(key), std::move(value));
+		m_index.emplace(m_items.front().first, m_items.begin());
+	}
+
+	void clear()
+	{
+		m_index.clear();
+		m_items.clear();
+	}
+
+private:
+	typedef std::list<std::pair<KeyT, ValueT>> Items;
+
+	size_t m_capacity;
+	Items m_items;
+	std::unordered_map<KeyT, typename Items::iterator, HashT> m_index;
+};
+
+#endif // NCMPCPP_UTILITY_LRU_CACHE_H